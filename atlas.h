@@ -0,0 +1,155 @@
+#ifndef ATLAS_H
+#define ATLAS_H
+#include "SDL2/SDL.h"
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+/// @brief A circle outline in a CircleAtlas.
+struct CircleSprite {
+    /// @brief The radius the outline was rasterized at, in pixels.
+    int radius;
+    /// @brief The position of the sprite in the atlas, in pixels.
+    int x, y;
+    /// @brief The position of the sprite in the atlas, as texture coordinates.
+    SDL_FRect source;
+};
+
+/// @brief A texture holding circle outlines at a set of quantized radii.
+/// @details Every outline is rasterized once with the midpoint algorithm, in
+/// white so that it can be tinted by the vertex color. Small radii are stored
+/// at every whole pixel, larger ones in steps that grow by a fixed ratio, so
+/// that a circle of any radius up to maxRadius is drawn by stretching the
+/// nearest sprite by a few percent at most. Sprites are packed into rows of a
+/// single texture, so any number of circles is one SDL_RenderGeometry call.
+class CircleAtlas {
+    private:
+        /// The nearest sprite for every whole radius up to maxRadius.
+        std::vector<int> lookup;
+
+        static void rasterize(std::vector<uint32_t> &pixels, int width, int cx, int cy, int radius) {
+            int x = radius;
+            int y = 0;
+            int err = 0;
+            while (x >= y) {
+                pixels[(cy + y) * width + cx + x] = 0xFFFFFFFF;
+                pixels[(cy + x) * width + cx + y] = 0xFFFFFFFF;
+                pixels[(cy + x) * width + cx - y] = 0xFFFFFFFF;
+                pixels[(cy + y) * width + cx - x] = 0xFFFFFFFF;
+                pixels[(cy - y) * width + cx - x] = 0xFFFFFFFF;
+                pixels[(cy - x) * width + cx - y] = 0xFFFFFFFF;
+                pixels[(cy - x) * width + cx + y] = 0xFFFFFFFF;
+                pixels[(cy - y) * width + cx + x] = 0xFFFFFFFF;
+                if (err <= 0) {
+                    y += 1;
+                    err += 2*y + 1;
+                }
+                if (err > 0) {
+                    x -= 1;
+                    err -= 2*x + 1;
+                }
+            }
+        }
+
+    public:
+        /// @brief The radius up to which every whole radius has its own sprite.
+        int exactRadius = 16;
+        /// @brief The ratio between the radii of consecutive sprites above exactRadius.
+        float step = 1.08;
+        /// @brief The largest radius in the atlas. Larger circles are not in the atlas.
+        int maxRadius = 128;
+        /// @brief The width of the texture, in pixels.
+        int width = 1024;
+        /// @brief The height of the texture, in pixels.
+        int height = 0;
+        std::vector<CircleSprite> sprites;
+        SDL_Texture *texture = nullptr;
+
+        /// @brief Rasterize the outlines and upload them into a texture.
+        /// @param renderer The renderer the texture is used with.
+        void create(SDL_Renderer *renderer) {
+            sprites.clear();
+            // Pack the sprites into rows, one pixel apart.
+            int x = 1, y = 1, rowHeight = 0;
+            int radius = 1;
+            while (radius <= maxRadius) {
+                int size = 2 * radius + 1;
+                if (x + size + 1 > width) {
+                    x = 1;
+                    y += rowHeight + 1;
+                    rowHeight = 0;
+                }
+                sprites.push_back({radius, x, y, {0, 0, 0, 0}});
+                x += size + 1;
+                rowHeight = std::max(rowHeight, size);
+                if (radius < exactRadius) radius++;
+                else radius = std::max(radius + 1, (int)std::lround(radius * step));
+            }
+            height = y + rowHeight + 1;
+
+            std::vector<uint32_t> pixels(width * height, 0);
+            for (int i = 0; i < sprites.size(); i++) {
+                CircleSprite &sprite = sprites[i];
+                int size = 2 * sprite.radius + 1;
+                rasterize(pixels, width, sprite.x + sprite.radius, sprite.y + sprite.radius, sprite.radius);
+                sprite.source.x = (float)sprite.x / width;
+                sprite.source.y = (float)sprite.y / height;
+                sprite.source.w = (float)size / width;
+                sprite.source.h = (float)size / height;
+            }
+
+            lookup.assign(maxRadius + 1, 0);
+            int nearest = 0;
+            for (int r = 1; r <= maxRadius; r++) {
+                while (nearest + 1 < sprites.size() &&
+                       std::abs(sprites[nearest + 1].radius - r) <= std::abs(sprites[nearest].radius - r)) {
+                    nearest++;
+                }
+                lookup[r] = nearest;
+            }
+
+            destroy();
+            texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888,
+                    SDL_TEXTUREACCESS_STATIC, width, height);
+            SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+            SDL_UpdateTexture(texture, NULL, pixels.data(), width * sizeof(uint32_t));
+        }
+
+        /// @brief Destroy the texture.
+        void destroy() {
+            if (texture != nullptr) SDL_DestroyTexture(texture);
+            texture = nullptr;
+        }
+
+        ~CircleAtlas() {
+            destroy();
+        }
+
+        /// @brief Find the sprite to draw a circle with.
+        /// @param radius The radius of the circle, in pixels.
+        /// @return The index of the sprite, or -1 if the circle is too large for the atlas.
+        int find(float radius) {
+            int r = std::lround(radius);
+            if (r > maxRadius || lookup.empty()) return -1;
+            return lookup[std::max(r, 1)];
+        }
+
+        /// @brief Get the rectangle a sprite covers on the screen when drawn as a circle.
+        /// @param sprite The index of the sprite.
+        /// @param center The center of the circle, in pixels.
+        /// @param radius The radius of the circle, in pixels.
+        SDL_FRect destination(int sprite, SDL_FPoint center, float radius) {
+            // The center pixel of the sprite covers [center, center + 1].
+            int r = sprites[sprite].radius;
+            float scale = radius / r;
+            SDL_FRect rect;
+            rect.x = center.x - r * scale;
+            rect.y = center.y - r * scale;
+            rect.w = (2 * r + 1) * scale;
+            rect.h = (2 * r + 1) * scale;
+            return rect;
+        }
+};
+
+#endif
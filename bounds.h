@@ -0,0 +1,108 @@
+#ifndef BOUNDS_H
+#define BOUNDS_H
+#include "Vector2D.h"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+/// @brief An axis-aligned rectangle in world coordinates.
+struct Bounds {
+    Vector2D min = Vector2D(INFINITY, INFINITY);
+    Vector2D max = Vector2D(-INFINITY, -INFINITY);
+
+    /// @brief Get bounds that contain every point.
+    static Bounds infinite() {
+        Bounds b;
+        b.min = Vector2D(-INFINITY, -INFINITY);
+        b.max = Vector2D(INFINITY, INFINITY);
+        return b;
+    }
+
+    /// @brief Get the bounds of a circle.
+    static Bounds circle(Vector2D center, float radius) {
+        Bounds b;
+        b.min = Vector2D(center.x - radius, center.y - radius);
+        b.max = Vector2D(center.x + radius, center.y + radius);
+        return b;
+    }
+
+    /// @brief Check whether the bounds contain no point.
+    bool empty() const {
+        return min.x > max.x || min.y > max.y;
+    }
+
+    /// @brief Grow the bounds to contain a point.
+    void expand(Vector2D point) {
+        expand(point.x, point.y);
+    }
+
+    void expand(float x, float y) {
+        min.x = std::min(min.x, x);
+        min.y = std::min(min.y, y);
+        max.x = std::max(max.x, x);
+        max.y = std::max(max.y, y);
+    }
+
+    /// @brief Grow the bounds to contain other bounds.
+    void expand(const Bounds &other) {
+        if (other.empty()) return;
+        expand(other.min);
+        expand(other.max);
+    }
+
+    /// @brief Grow the bounds by a margin on every side.
+    Bounds padded(float margin) const {
+        Bounds b = *this;
+        b.min = Vector2D(min.x - margin, min.y - margin);
+        b.max = Vector2D(max.x + margin, max.y + margin);
+        return b;
+    }
+
+    /// @brief Get the bounds moved by an offset.
+    Bounds translated(Vector2D offset) const {
+        Bounds b = *this;
+        b.min = Vector2D(min.x + offset.x, min.y + offset.y);
+        b.max = Vector2D(max.x + offset.x, max.y + offset.y);
+        return b;
+    }
+
+    /// @brief Check whether two bounds overlap.
+    bool intersects(const Bounds &other) const {
+        return !empty() && !other.empty() &&
+               min.x <= other.max.x && other.min.x <= max.x &&
+               min.y <= other.max.y && other.min.y <= max.y;
+    }
+};
+
+/// @brief The bounds of consecutive chunks of a polyline.
+/// @details Chunk i covers the points from i * size to (i + 1) * size
+/// inclusive, so neighbouring chunks share a point and together cover every
+/// segment of the polyline once. A viewer culls a long polyline chunk by chunk
+/// and only submits the chunks it can see.
+struct ChunkBounds {
+    /// @brief The number of segments per chunk.
+    int size = 64;
+    std::vector<Bounds> chunks;
+    /// @brief The bounds of the whole polyline.
+    Bounds total;
+
+    /// @brief Compute the bounds of the chunks of a polyline.
+    /// @param x The x coordinates of the points.
+    /// @param y The y coordinates of the points.
+    /// @param n The number of points.
+    void compute(const float *x, const float *y, int n) {
+        int count = n > 1 ? (n - 2) / size + 1 : 0;
+        chunks.assign(count, Bounds());
+        total = Bounds();
+        for (int c = 0; c < count; c++) {
+            int last = std::min((c + 1) * size, n - 1);
+            Bounds &b = chunks[c];
+            for (int i = c * size; i <= last; i++) {
+                b.expand(x[i], y[i]);
+            }
+            total.expand(b);
+        }
+    }
+};
+
+#endif
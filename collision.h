@@ -0,0 +1,269 @@
+#ifndef COLLISION_H
+#define COLLISION_H
+#include "physics.h"
+#include "Vector2D.h"
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+/// @brief A uniform grid of cells, hashed by their integer coordinates.
+/// @details Each body is inserted into every cell its swept bounding box
+/// touches. Two bodies can only collide if they share a cell, so only bodies
+/// in the same cell have to be tested against each other.
+///
+/// The cell size changes from one tick to the next, so the keys of a tick
+/// are mostly new. Only the cells used since the last clear are visited, and
+/// the map is emptied once it holds many more cells than are in use, so both
+/// the time and the memory stay proportional to the number of bodies.
+class SpatialHash {
+    public:
+        float cellSize = 1;
+        std::unordered_map<uint64_t, std::vector<int>> cells;
+        /// @brief The keys of the cells that hold bodies, in the order they were first used.
+        std::vector<uint64_t> used;
+
+        /// @brief Remove all bodies from the hash and set a new cell size.
+        /// @param cellSize The side length of a single cell.
+        void clear(float cellSize) {
+            this->cellSize = cellSize;
+            if (cells.size() > 4 * used.size() + 64) {
+                cells.clear();
+            } else {
+                for (int i = 0; i < used.size(); i++) {
+                    cells[used[i]].clear();
+                }
+            }
+            used.clear();
+        }
+
+        /// @brief Get the coordinate of the cell containing the given value.
+        /// @details Coordinates are clamped to +-2^30, so far away or escaping
+        /// bodies share the outermost cells instead of overflowing the int.
+        int cellCoordinate(float value) {
+            const float limit = 1 << 30;
+            float cell = std::floor(value / cellSize);
+            if (!(cell > -limit)) return -(1 << 30);
+            if (cell > limit) return 1 << 30;
+            return (int)cell;
+        }
+
+        /// @brief Get the hash key of the cell with the given coordinates.
+        /// @details Both coordinates are reinterpreted as unsigned, since
+        /// shifting a negative value is undefined.
+        static uint64_t key(int x, int y) {
+            return ((uint64_t)(uint32_t)x << 32) | (uint32_t)y;
+        }
+
+        /// @brief Insert a body into all cells overlapped by a bounding box.
+        /// @param index The index of the body in the physics world.
+        /// @param min The minimum corner of the bounding box.
+        /// @param max The maximum corner of the bounding box.
+        void insert(int index, Vector2D min, Vector2D max) {
+            int x0 = cellCoordinate(min.x), x1 = cellCoordinate(max.x);
+            int y0 = cellCoordinate(min.y), y1 = cellCoordinate(max.y);
+            for (int x = x0; x <= x1; x++) {
+                for (int y = y0; y <= y1; y++) {
+                    uint64_t k = key(x, y);
+                    std::vector<int> &cell = cells[k];
+                    if (cell.empty()) used.push_back(k);
+                    cell.push_back(index);
+                }
+            }
+        }
+};
+
+/// @brief A collision between two bodies found by the swept test.
+struct Contact {
+    int first;
+    int second;
+    /// @brief The fraction of the last time step at which the bodies touched.
+    float time;
+};
+
+/// @brief Detects colliding bodies and merges them.
+/// @details The collision stage runs after PhysicsWorld::update. Bodies are
+/// binned into a SpatialHash using the bounding box of the path they swept
+/// during the last time step, and only bodies sharing a cell are tested
+/// against each other with a swept-circle test. Colliding bodies are merged
+/// into one body, conserving mass and momentum. The cost is close to linear in
+/// the number of bodies as long as they are not all packed into a few cells.
+///
+/// The cells are sized after the median swept body. The few bodies that are
+/// much larger or faster than that would cover many cells, so they are kept
+/// out of the hash and tested against all other bodies instead.
+class CollisionSystem {
+    private:
+        SpatialHash hash;
+        std::vector<Vector2D> boundsMin;
+        std::vector<Vector2D> boundsMax;
+        std::vector<float> extents;
+        std::vector<float> median;
+        std::vector<int> oversized;
+        std::vector<Contact> contacts;
+        std::vector<int> parent;
+
+        /// @brief Bodies whose swept box is wider than this many cells are kept out of the hash.
+        static constexpr float oversizedCells = 4;
+
+        bool overlap(int a, int b) {
+            return boundsMin[a].x <= boundsMax[b].x && boundsMin[b].x <= boundsMax[a].x &&
+                   boundsMin[a].y <= boundsMax[b].y && boundsMin[b].y <= boundsMax[a].y;
+        }
+
+        void test(PhysicsWorld &world, int a, int b, float dt) {
+            float time;
+            if (sweptCircles(world.bodies[a], world.bodies[b], dt, time)) {
+                contacts.push_back({a, b, time});
+            }
+        }
+
+        int find(int i) {
+            while (parent[i] != i) {
+                parent[i] = parent[parent[i]];
+                i = parent[i];
+            }
+            return i;
+        }
+
+    public:
+        /// @brief For every body before the last update, the index it has now.
+        /// @details Bodies that were merged map to the index of the body they
+        /// were merged into.
+        std::vector<int> remap;
+
+        /// @brief Test two moving circles for a collision during the last time step.
+        /// @param a The first body, at the end of the time step.
+        /// @param b The second body, at the end of the time step.
+        /// @param dt The length of the time step.
+        /// @param time Set to the fraction of the time step at which the bodies first touch.
+        /// @return True if the bodies touched at any point during the time step.
+        static bool sweptCircles(PhysicsBody &a, PhysicsBody &b, float dt, float &time) {
+            Vector2D start = (b.position - b.velocity * dt) - (a.position - a.velocity * dt);
+            Vector2D motion = (b.velocity - a.velocity) * dt;
+            float radius = a.getRadius() + b.getRadius();
+            float c = start.x * start.x + start.y * start.y - radius * radius;
+            if (c <= 0) {
+                time = 0;
+                return true;
+            }
+            float a2 = motion.x * motion.x + motion.y * motion.y;
+            float b2 = 2 * (start.x * motion.x + start.y * motion.y);
+            if (a2 == 0 || b2 >= 0) return false;
+            float discriminant = b2 * b2 - 4 * a2 * c;
+            if (discriminant < 0) return false;
+            time = (-b2 - std::sqrt(discriminant)) / (2 * a2);
+            return time <= 1;
+        }
+
+        /// @brief Find and merge all bodies that collided during the last time step.
+        /// @param world The physics world, already updated with the time step.
+        /// @param dt The time step the world was updated with.
+        /// @return The number of bodies that were merged away.
+        /// @details Bodies are merged in the order in which they touched. The
+        /// merged body keeps the lower index, the combined mass and momentum,
+        /// and is placed at the center of mass. After merging, remap holds the
+        /// new index of every body.
+        int resolve(PhysicsWorld &world, float dt) {
+            int n = world.bodies.size();
+            remap.resize(n);
+            for (int i = 0; i < n; i++) remap[i] = i;
+            if (n < 2) return 0;
+
+            boundsMin.resize(n);
+            boundsMax.resize(n);
+            extents.resize(n);
+            for (int i = 0; i < n; i++) {
+                PhysicsBody &body = world.bodies[i];
+                Vector2D start = body.position - body.velocity * dt;
+                float radius = body.getRadius();
+                boundsMin[i] = Vector2D(std::min(start.x, body.position.x) - radius,
+                                        std::min(start.y, body.position.y) - radius);
+                boundsMax[i] = Vector2D(std::max(start.x, body.position.x) + radius,
+                                        std::max(start.y, body.position.y) + radius);
+                extents[i] = std::max(boundsMax[i].x - boundsMin[i].x, boundsMax[i].y - boundsMin[i].y);
+            }
+            // Cells about the size of the median swept body keep both the
+            // number of cells per body and the number of bodies per cell
+            // small. A single fast or heavy body does not move the median.
+            median = extents;
+            std::nth_element(median.begin(), median.begin() + n / 2, median.end());
+            float cellSize = std::max(median[n / 2], 1e-3f);
+            hash.clear(cellSize);
+            oversized.clear();
+            for (int i = 0; i < n; i++) {
+                if (!(extents[i] <= oversizedCells * cellSize)) {
+                    oversized.push_back(i);
+                    continue;
+                }
+                hash.insert(i, boundsMin[i], boundsMax[i]);
+            }
+
+            contacts.clear();
+            for (int c = 0; c < hash.used.size(); c++) {
+                uint64_t cell = hash.used[c];
+                std::vector<int> &members = hash.cells[cell];
+                for (int i = 0; i < members.size(); i++) {
+                    for (int j = i + 1; j < members.size(); j++) {
+                        int a = std::min(members[i], members[j]);
+                        int b = std::max(members[i], members[j]);
+                        if (!overlap(a, b)) continue;
+                        // A pair sharing several cells is only tested in the
+                        // first cell of the overlap of their bounding boxes.
+                        int x = hash.cellCoordinate(std::max(boundsMin[a].x, boundsMin[b].x));
+                        int y = hash.cellCoordinate(std::max(boundsMin[a].y, boundsMin[b].y));
+                        if (SpatialHash::key(x, y) != cell) continue;
+                        test(world, a, b, dt);
+                    }
+                }
+            }
+            // Oversized bodies are not in the hash and are tested against
+            // every other body, each pair of oversized bodies once.
+            for (int i = 0; i < oversized.size(); i++) {
+                int a = oversized[i];
+                for (int b = 0; b < n; b++) {
+                    if (b == a || !overlap(a, b)) continue;
+                    if (!(extents[b] <= oversizedCells * cellSize) && b < a) continue;
+                    test(world, std::min(a, b), std::max(a, b), dt);
+                }
+            }
+            if (contacts.empty()) return 0;
+
+            std::sort(contacts.begin(), contacts.end(),
+                    [](const Contact &a, const Contact &b) { return a.time < b.time; });
+            parent.resize(n);
+            for (int i = 0; i < n; i++) parent[i] = i;
+            int merged = 0;
+            for (int c = 0; c < contacts.size(); c++) {
+                int a = find(contacts[c].first);
+                int b = find(contacts[c].second);
+                if (a == b) continue;
+                if (b < a) std::swap(a, b);
+                PhysicsBody &target = world.bodies[a];
+                PhysicsBody &source = world.bodies[b];
+                float mass = target.mass + source.mass;
+                target.position = (target.position * target.mass + source.position * source.mass) / mass;
+                target.velocity = (target.velocity * target.mass + source.velocity * source.mass) / mass;
+                target.acceleration = (target.acceleration * target.mass + source.acceleration * source.mass) / mass;
+                target.mass = mass;
+                parent[b] = a;
+                merged++;
+            }
+
+            int next = 0;
+            for (int i = 0; i < n; i++) {
+                if (find(i) != i) continue;
+                remap[i] = next;
+                if (next != i) world.bodies[next] = world.bodies[i];
+                next++;
+            }
+            for (int i = 0; i < n; i++) {
+                remap[i] = remap[find(i)];
+            }
+            world.bodies.resize(next);
+            return merged;
+        }
+};
+
+#endif
@@ -0,0 +1,238 @@
+#ifndef COMPONENTS_H
+#define COMPONENTS_H
+#include "graphics.h"
+#include "physics.h"
+#include "corotating.h"
+#include "relative.h"
+#include <vector>
+#include <cstdint>
+
+/// @brief The quantity of a body an arrow shows.
+enum class ArrowKind : uint8_t {
+    /// @brief The velocity, relative to the rotating axes in the co-rotating view.
+    Velocity,
+    /// @brief The Coriolis acceleration, only in the co-rotating view.
+    Coriolis,
+    /// @brief The centrifugal acceleration, only in the co-rotating view.
+    Centrifugal
+};
+
+/// @brief Circles at the positions of bodies, one entry per marker.
+struct MarkerComponents {
+    std::vector<int> body;
+    std::vector<uint32_t> color;
+
+    int size() {
+        return body.size();
+    }
+};
+
+/// @brief Arrows from the positions of bodies, one entry per arrow.
+struct ArrowComponents {
+    std::vector<int> body;
+    std::vector<ArrowKind> kind;
+    std::vector<uint32_t> color;
+    /// @brief The factor from the shown quantity to the length of the arrow.
+    std::vector<float> scale;
+
+    int size() {
+        return body.size();
+    }
+};
+
+/// @brief Sampled paths of bodies relative to a reference, one entry per path.
+struct TrajectoryComponents {
+    std::vector<int> body;
+    std::vector<uint32_t> color;
+
+    int size() {
+        return body.size();
+    }
+};
+
+/// @brief The frame a viewport shows paths in.
+/// @details Drawables resolve it from the viewport being drawn, so every
+/// viewport of a camera can show the same paths relative to a different body.
+/// The paths themselves are cached by the RelativeTrajectoryEngine and shared.
+struct ViewReference {
+    /// @brief The body the paths are relative to, or -1 for the world frame.
+    int reference = -1;
+    FrameRotation rotation = FrameRotation::None;
+    int secondary = 0;
+    /// @brief Where the reference body is drawn.
+    Vector2D anchor;
+    /// @brief Whether positions are taken from the co-rotating frame.
+    bool corotating = false;
+
+    /// @brief Check whether a body stays at the anchor, so its path is a single point.
+    bool fixes(int body) {
+        return body == reference && rotation != FrameRotation::Barycentric;
+    }
+
+    /// @brief Resolve the frame of a viewport.
+    /// @param viewport The viewport.
+    /// @param world The physics world, for the position of the reference body.
+    /// @param frame The co-rotating frame, used if the viewport shows it and it is enabled.
+    static ViewReference of(Viewport *viewport, PhysicsWorld *world, CorotatingFrame *frame) {
+        ViewReference view;
+        if (viewport->corotating && frame->enabled) {
+            // The paths share the barycentric frame of the bodies, so the
+            // origin of the frame is drawn where the bodies are drawn around.
+            view.reference = frame->primary;
+            view.rotation = FrameRotation::Barycentric;
+            view.secondary = frame->secondary;
+            view.anchor = frame->origin;
+            view.corotating = true;
+        } else if (viewport->reference >= 0 && viewport->reference < world->bodies.size()) {
+            view.reference = viewport->reference;
+            view.anchor = world->bodies[viewport->reference].getPosition();
+        }
+        return view;
+    }
+};
+
+/// @brief Draws the markers, arrows and paths of all bodies from arrays of components.
+/// @details Instead of one Drawable per body, every kind of visual is a plain
+/// array of components that refer to bodies by index. Drawing is one loop
+/// per kind: the loop gathers the positions of the bodies from the world,
+/// or from the co-rotating frame, into coordinate arrays and hands the whole
+/// batch to the camera, so there is no per-body virtual call or pointer
+/// chase. Drawables remain for visuals that exist once, like the tracked
+/// trajectory with its markers.
+class BodyVisuals : public Drawable {
+    private:
+        PhysicsWorld *world;
+        CorotatingFrame *frame;
+        RelativeTrajectoryEngine *engine;
+        std::vector<float> x, y, dx, dy, radius;
+        std::vector<uint32_t> colors;
+        /// The frame of the viewport being drawn.
+        ViewReference view;
+
+        /// Get the position of a body in the current view.
+        Vector2D position(int body) {
+            if (!view.corotating) return world->bodies[body].position;
+            CorotatingStates &states = frame->states;
+            return frame->origin + Vector2D(states.x[body], states.y[body]);
+        }
+
+        /// Get the quantity an arrow shows, or false if it is not shown in the current view.
+        bool quantity(int body, ArrowKind kind, Vector2D &value) {
+            if (!view.corotating) {
+                value = world->bodies[body].velocity;
+                return kind == ArrowKind::Velocity;
+            }
+            CorotatingStates &states = frame->states;
+            switch (kind) {
+                case ArrowKind::Velocity: value = Vector2D(states.vx[body], states.vy[body]); break;
+                case ArrowKind::Coriolis: value = Vector2D(states.coriolisX[body], states.coriolisY[body]); break;
+                case ArrowKind::Centrifugal: value = Vector2D(states.centrifugalX[body], states.centrifugalY[body]); break;
+            }
+            return true;
+        }
+
+        void drawMarkers(Camera *camera) {
+            const Bounds &visible = camera->getVisibleBounds();
+            x.clear(); y.clear(); radius.clear(); colors.clear();
+            for (int i = 0; i < markers.size(); i++) {
+                int b = markers.body[i];
+                Vector2D p = position(b);
+                float r = world->bodies[b].getRadius();
+                if (!visible.intersects(Bounds::circle(p, r))) continue;
+                x.push_back(p.x);
+                y.push_back(p.y);
+                radius.push_back(r);
+                colors.push_back(markers.color[i]);
+            }
+            camera->drawCircles(x.data(), y.data(), radius.data(), colors.data(), x.size());
+        }
+
+        void drawArrows(Camera *camera) {
+            const Bounds &visible = camera->getVisibleBounds();
+            x.clear(); y.clear(); dx.clear(); dy.clear(); colors.clear();
+            for (int i = 0; i < arrows.size(); i++) {
+                int b = arrows.body[i];
+                Vector2D value;
+                if (!quantity(b, arrows.kind[i], value)) continue;
+                Vector2D p = position(b);
+                value = value * arrows.scale[i];
+                Bounds extent;
+                extent.expand(p);
+                extent.expand(p + value);
+                if (!visible.intersects(extent)) continue;
+                x.push_back(p.x);
+                y.push_back(p.y);
+                dx.push_back(value.x);
+                dy.push_back(value.y);
+                colors.push_back(arrows.color[i]);
+            }
+            camera->drawArrows(x.data(), y.data(), dx.data(), dy.data(), colors.data(), x.size());
+        }
+
+        void drawTrajectories(Camera *camera) {
+            if (!engine->ready()) return;
+            for (int i = 0; i < trajectories.size(); i++) {
+                int b = trajectories.body[i];
+                if (view.fixes(b) || b >= engine->bodies()) continue;
+                RelativePath &path = engine->path(b, view.reference, view.rotation, view.secondary);
+                camera->setDrawColor(Color::fromPacked(trajectories.color[i]));
+                camera->drawPolyline(path.x.data(), path.y.data(), path.size(), path.chunks, view.anchor);
+            }
+        }
+
+    public:
+        MarkerComponents markers;
+        ArrowComponents arrows;
+        TrajectoryComponents trajectories;
+        float accelerationScale = 0.05;
+
+        /// @brief Create the visuals of the bodies of a world.
+        /// @param world The physics world.
+        /// @param frame The co-rotating frame, used by viewports that show it.
+        /// @param engine The source of the paths.
+        BodyVisuals(PhysicsWorld *world, CorotatingFrame *frame, RelativeTrajectoryEngine *engine) {
+            this->world = world;
+            this->frame = frame;
+            this->engine = engine;
+            this->depth = 1;
+            this->threadSafe = true;
+        }
+
+        /// @brief Add a marker and the arrows of a body.
+        /// @param body The index of the body.
+        /// @param path Whether to draw the path of the body too.
+        void addBody(int body, bool path = true) {
+            markers.body.push_back(body);
+            markers.color.push_back(Color::white().packed());
+            ArrowKind kinds[] = {ArrowKind::Velocity, ArrowKind::Coriolis, ArrowKind::Centrifugal};
+            Color arrowColors[] = {Color::red(), Color::cyan(), Color::magenta()};
+            for (int k = 0; k < 3; k++) {
+                arrows.body.push_back(body);
+                arrows.kind.push_back(kinds[k]);
+                arrows.color.push_back(arrowColors[k].packed());
+                arrows.scale.push_back(k == 0 ? 1 : accelerationScale);
+            }
+            if (path) {
+                trajectories.body.push_back(body);
+                trajectories.color.push_back(Color::darkGray().packed());
+            }
+            markDirty();
+        }
+
+        /// @brief Remove all components.
+        void clear() {
+            markers = MarkerComponents();
+            arrows = ArrowComponents();
+            trajectories = TrajectoryComponents();
+            markDirty();
+        }
+
+        void draw(Camera *camera) {
+            view = ViewReference::of(camera->getViewport(), world, frame);
+            drawTrajectories(camera);
+            drawMarkers(camera);
+            drawArrows(camera);
+        }
+};
+
+#endif
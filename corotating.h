@@ -0,0 +1,141 @@
+#ifndef COROTATING_H
+#define COROTATING_H
+#include "physics.h"
+#include "Vector2D.h"
+#include <vector>
+#include <cmath>
+
+/// @brief The states of all bodies as seen from a co-rotating frame.
+/// @details Every quantity is stored as a separate array with one entry per body.
+struct CorotatingStates {
+    std::vector<float> x, y;
+    std::vector<float> vx, vy;
+    std::vector<float> coriolisX, coriolisY;
+    std::vector<float> centrifugalX, centrifugalY;
+
+    void resize(int n) {
+        x.resize(n); y.resize(n);
+        vx.resize(n); vy.resize(n);
+        coriolisX.resize(n); coriolisY.resize(n);
+        centrifugalX.resize(n); centrifugalY.resize(n);
+    }
+};
+
+/// @brief A frame that follows and rotates with the line between two bodies.
+/// @details The origin of the frame is the barycenter of the primary and the
+/// secondary body and its x axis points from the primary towards the
+/// secondary, so in a system dominated by the two bodies the pair stands still
+/// and structures like Lagrange points and horseshoe orbits become visible.
+/// The forces between the two bodies are equal and opposite, so their
+/// barycenter does not accelerate, and the Coriolis and centrifugal terms are
+/// the only fictitious accelerations in the frame; measured from an
+/// accelerating body the frame would also need the opposite of its
+/// acceleration. The frame is updated once per tick, after which the states
+/// of all bodies are transformed into it in one batch pass: positions,
+/// velocities relative to the rotating axes, and the Coriolis and centrifugal
+/// accelerations a body feels in the frame.
+class CorotatingFrame {
+    private:
+        std::vector<float> px, py, pvx, pvy;
+
+    public:
+        /// @brief Whether the co-rotating view is active.
+        bool enabled = false;
+        /// @brief The body the x axis points away from.
+        int primary = 0;
+        /// @brief The body on the positive x axis of the frame.
+        int secondary = 1;
+        /// @brief The position of the origin, the barycenter of the two bodies, in the world.
+        Vector2D origin;
+        /// @brief The velocity of the origin in the world.
+        Vector2D originVelocity;
+        /// @brief The cosine of the angle of the x axis.
+        float cosine = 1;
+        /// @brief The sine of the angle of the x axis.
+        float sine = 0;
+        /// @brief The angular velocity of the frame.
+        float omega = 0;
+        /// @brief The states of all bodies in the frame after the last update.
+        CorotatingStates states;
+
+        /// @brief Update the frame from the current state of the two bodies and transform all bodies into it.
+        /// @param world The physics world.
+        void update(PhysicsWorld &world) {
+            int n = world.bodies.size();
+            if (primary >= n || secondary >= n || primary == secondary) {
+                enabled = false;
+                return;
+            }
+            PhysicsBody &a = world.bodies[primary];
+            PhysicsBody &b = world.bodies[secondary];
+            Vector2D r = b.position - a.position;
+            Vector2D v = b.velocity - a.velocity;
+            float distance2 = r.x * r.x + r.y * r.y;
+            float distance = std::sqrt(distance2);
+            float total = a.mass + b.mass;
+            origin = (a.position * a.mass + b.position * b.mass) / total;
+            originVelocity = (a.velocity * a.mass + b.velocity * b.mass) / total;
+            cosine = r.x / distance;
+            sine = r.y / distance;
+            omega = (r.x * v.y - r.y * v.x) / distance2;
+
+            px.resize(n); py.resize(n); pvx.resize(n); pvy.resize(n);
+            for (int i = 0; i < n; i++) {
+                px[i] = world.bodies[i].position.x;
+                py[i] = world.bodies[i].position.y;
+                pvx[i] = world.bodies[i].velocity.x;
+                pvy[i] = world.bodies[i].velocity.y;
+            }
+            states.resize(n);
+            transform(px.data(), py.data(), pvx.data(), pvy.data(), states, n);
+        }
+
+        /// @brief Transform a batch of world states into the frame.
+        /// @param x The world x coordinates.
+        /// @param y The world y coordinates.
+        /// @param vx The world x velocities.
+        /// @param vy The world y velocities.
+        /// @param out The states in the frame, which must already hold n entries.
+        /// @param n The number of states.
+        void transform(const float *__restrict x, const float *__restrict y,
+                       const float *__restrict vx, const float *__restrict vy,
+                       CorotatingStates &out, int n) {
+            float ox = origin.x, oy = origin.y;
+            float ovx = originVelocity.x, ovy = originVelocity.y;
+            float c = cosine, s = sine, w = omega;
+            float *__restrict rx = out.x.data();
+            float *__restrict ry = out.y.data();
+            float *__restrict rvx = out.vx.data();
+            float *__restrict rvy = out.vy.data();
+            float *__restrict cx = out.coriolisX.data();
+            float *__restrict cy = out.coriolisY.data();
+            float *__restrict fx = out.centrifugalX.data();
+            float *__restrict fy = out.centrifugalY.data();
+            for (int i = 0; i < n; i++) {
+                float dx = x[i] - ox, dy = y[i] - oy;
+                float dvx = vx[i] - ovx, dvy = vy[i] - ovy;
+                float lx = c * dx + s * dy;
+                float ly = c * dy - s * dx;
+                // Velocity seen by an observer on the rotating axes: v - w x r.
+                float lvx = c * dvx + s * dvy + w * ly;
+                float lvy = c * dvy - s * dvx - w * lx;
+                rx[i] = lx;
+                ry[i] = ly;
+                rvx[i] = lvx;
+                rvy[i] = lvy;
+                // Coriolis: -2 w x v, centrifugal: w^2 r.
+                cx[i] = 2 * w * lvy;
+                cy[i] = -2 * w * lvx;
+                fx[i] = w * w * lx;
+                fy[i] = w * w * ly;
+            }
+        }
+
+        /// @brief Transform a world position into the frame.
+        Vector2D toFrame(Vector2D position) {
+            Vector2D d = position - origin;
+            return Vector2D(cosine * d.x + sine * d.y, cosine * d.y - sine * d.x);
+        }
+};
+
+#endif
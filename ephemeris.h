@@ -0,0 +1,214 @@
+#ifndef EPHEMERIS_H
+#define EPHEMERIS_H
+#include "prediction.h"
+#include "Vector2D.h"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+/// @brief The predicted path of a single body as piecewise Chebyshev polynomials.
+/// @details The time span of a prediction is split into segments of equal
+/// length, and the position of the body in each segment is approximated by a
+/// Chebyshev series in x and y, the way planetary ephemerides are stored.
+/// Because the segments have equal length, finding the segment of a time is a
+/// single division, so the position and velocity at any time are evaluated in
+/// constant time.
+class Ephemeris {
+    private:
+        /// The cosines cos(pi j (k + 1/2) / n) of the fit, n per row j, computed once per fit.
+        std::vector<float> basis;
+
+        /// Evaluate a Chebyshev series at x in [-1, 1] with Clenshaw's recurrence.
+        static float clenshaw(const float *c, int n, float x) {
+            float b1 = 0, b2 = 0;
+            for (int k = n - 1; k >= 1; k--) {
+                float b0 = 2 * x * b1 - b2 + c[k];
+                b2 = b1;
+                b1 = b0;
+            }
+            return x * b1 - b2 + c[0];
+        }
+
+        /// Compute the Chebyshev coefficients of values sampled at the Chebyshev-Gauss nodes.
+        static void coefficients(const float *f, const float *basis, float *c, int n) {
+            for (int j = 0; j < n; j++) {
+                const float *row = &basis[j * n];
+                float sum = 0;
+                for (int k = 0; k < n; k++) {
+                    sum += f[k] * row[k];
+                }
+                c[j] = sum * 2 / n;
+            }
+            c[0] *= 0.5f;
+        }
+
+        /// Fit all segments with the current segment count and return the largest error estimate.
+        float fitSegments(Propagation &propagation, int body) {
+            int n = degree + 1;
+            cx.assign(segments * n, 0);
+            cy.assign(segments * n, 0);
+            dx.assign(segments * n, 0);
+            dy.assign(segments * n, 0);
+            std::vector<float> fx(n), fy(n), fvx(n), fvy(n);
+            float worst = 0;
+            for (int s = 0; s < segments; s++) {
+                float a = start + s * segmentLength;
+                float half = 0.5f * segmentLength;
+                int sample = propagation.findInterval(a);
+                for (int k = 0; k < n; k++) {
+                    // Chebyshev-Gauss nodes, from the end of the segment to its start.
+                    float t = a + half * (1 + basis[n + k]);
+                    while (sample + 1 < propagation.size() - 1 && propagation.times[sample + 1] <= t) sample++;
+                    while (sample > 0 && propagation.times[sample] > t) sample--;
+                    Vector2D position, velocity;
+                    propagation.interpolate(body, sample, t, position, velocity);
+                    fx[k] = position.x;
+                    fy[k] = position.y;
+                    fvx[k] = velocity.x;
+                    fvy[k] = velocity.y;
+                }
+                float *x = &cx[s * n];
+                float *y = &cy[s * n];
+                coefficients(fx.data(), basis.data(), x, n);
+                coefficients(fy.data(), basis.data(), y, n);
+                // The velocity is fitted on its own rather than differentiated,
+                // so it follows the integrator's velocities instead of the
+                // slope of the position fit.
+                coefficients(fvx.data(), basis.data(), &dx[s * n], n);
+                coefficients(fvy.data(), basis.data(), &dy[s * n], n);
+                // The last coefficients bound the truncation error of a
+                // smooth function well enough to decide on subdivision. The
+                // velocity error is weighted by the segment length so both are
+                // measured as a distance.
+                float *vx = &dx[s * n];
+                float *vy = &dy[s * n];
+                float error = std::fabs(x[n - 1]) + std::fabs(y[n - 1]);
+                float velocityError = std::fabs(vx[n - 1]) + std::fabs(vy[n - 1]);
+                if (n > 1) {
+                    error += std::fabs(x[n - 2]) + std::fabs(y[n - 2]);
+                    velocityError += std::fabs(vx[n - 2]) + std::fabs(vy[n - 2]);
+                }
+                worst = std::max(worst, std::max(error, velocityError * half));
+            }
+            return worst;
+        }
+
+    public:
+        /// @brief The time at which the ephemeris starts.
+        float start = 0;
+        /// @brief The time at which the ephemeris ends.
+        float end = 0;
+        /// @brief The length of a single segment.
+        float segmentLength = 0;
+        /// @brief The number of segments.
+        int segments = 0;
+        /// @brief The degree of the polynomials.
+        int degree = 8;
+        /// @brief The estimated largest position error of the fit.
+        float error = 0;
+        /// @brief The position coefficients, degree + 1 per segment.
+        std::vector<float> cx, cy;
+        /// @brief The velocity coefficients, degree + 1 per segment.
+        std::vector<float> dx, dy;
+
+        /// @brief Fit the predicted path of a body.
+        /// @param propagation The propagation to fit.
+        /// @param body The index of the body to fit.
+        /// @param tolerance The largest position error to aim for.
+        /// @param maxSegments The largest number of segments to use.
+        /// @details The number of segments starts at one per eight samples and
+        /// is doubled until the estimated error is below the tolerance or the
+        /// maximum number of segments is reached.
+        void fit(Propagation &propagation, int body, float tolerance, int maxSegments = 4096) {
+            segments = 0;
+            error = 0;
+            if (propagation.size() < 2) return;
+            start = propagation.times.front();
+            end = propagation.times.back();
+            segments = std::max(1, std::min(maxSegments, propagation.size() / 8));
+            // Row 1 also holds the nodes, so it is kept for a degree of 0.
+            int n = degree + 1;
+            int rows = std::max(n, 2);
+            basis.resize(rows * n);
+            for (int j = 0; j < rows; j++) {
+                for (int k = 0; k < n; k++) basis[j * n + k] = std::cos(M_PI * j * (k + 0.5f) / n);
+            }
+            while (true) {
+                segmentLength = (end - start) / segments;
+                error = fitSegments(propagation, body);
+                if (error <= tolerance || segments * 2 > maxSegments) break;
+                segments *= 2;
+            }
+        }
+
+        /// @brief Move the fitted path.
+        /// @param offset The displacement to add to every position.
+        void translate(Vector2D offset) {
+            int n = degree + 1;
+            for (int s = 0; s < segments; s++) {
+                cx[s * n] += offset.x;
+                cy[s * n] += offset.y;
+            }
+        }
+
+        /// @brief Check whether the ephemeris holds a fitted path.
+        bool empty() {
+            return segments == 0;
+        }
+
+        /// @brief Evaluate the position and velocity of the body at a time.
+        /// @param time The time to evaluate at. It is clamped to the span of the ephemeris.
+        /// @param position Set to the position of the body.
+        /// @param velocity Set to the velocity of the body.
+        void evaluate(float time, Vector2D &position, Vector2D &velocity) {
+            int n = degree + 1;
+            float u = segmentLength > 0 ? (time - start) / segmentLength : 0;
+            int s = std::min(std::max((int)u, 0), segments - 1);
+            float x = std::min(std::max(2 * (u - s) - 1, -1.0f), 1.0f);
+            position = Vector2D(clenshaw(&cx[s * n], n, x), clenshaw(&cy[s * n], n, x));
+            velocity = Vector2D(clenshaw(&dx[s * n], n, x), clenshaw(&dy[s * n], n, x));
+        }
+
+        /// @brief Evaluate the position of the body at a time.
+        /// @see evaluate
+        Vector2D position(float time) {
+            Vector2D position, velocity;
+            evaluate(time, position, velocity);
+            return position;
+        }
+
+        /// @brief Evaluate the velocity of the body at a time.
+        /// @see evaluate
+        Vector2D velocity(float time) {
+            Vector2D position, velocity;
+            evaluate(time, position, velocity);
+            return velocity;
+        }
+};
+
+/// @brief The ephemerides of all bodies of a propagation.
+class EphemerisSet {
+    public:
+        std::vector<Ephemeris> bodies;
+
+        /// @brief Fit the predicted paths of all bodies.
+        /// @param propagation The propagation to fit.
+        /// @param tolerance The largest position error to aim for.
+        /// @see Ephemeris::fit
+        void fit(Propagation &propagation, float tolerance) {
+            bodies.resize(propagation.bodies());
+            for (int i = 0; i < bodies.size(); i++) {
+                bodies[i].fit(propagation, i, tolerance);
+            }
+        }
+
+        /// @brief Move the fitted paths of all bodies.
+        /// @see Ephemeris::translate
+        void translate(Vector2D offset) {
+            for (int i = 0; i < bodies.size(); i++) {
+                bodies[i].translate(offset);
+            }
+        }
+};
+
+#endif
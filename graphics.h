@@ -3,7 +3,16 @@
 #include "SDL2/SDL.h"
 #include "Vector2D.h"
 #include "Frame2D.h"
+#include "transform.h"
+#include "renderqueue.h"
+#include "atlas.h"
+#include "bounds.h"
+#include "scene.h"
+#include "threadpool.h"
 #include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <memory>
 
 class Color {
     public:
@@ -32,6 +41,16 @@ class Color {
             this->b = 0;
             this->a = 255;
         }
+
+    /// @brief Get the color packed into 32 bits as 0xRRGGBBAA.
+    uint32_t packed() {
+        return (uint32_t)r << 24 | (uint32_t)g << 16 | (uint32_t)b << 8 | (uint32_t)a;
+    }
+
+    /// @brief Get a color from 32 bits packed as 0xRRGGBBAA.
+    static Color fromPacked(uint32_t color) {
+        return Color(color >> 24, (color >> 16) & 255, (color >> 8) & 255, color & 255);
+    }
     
     static Color black() {
         return Color(0, 0, 0);
@@ -96,59 +115,6 @@ void setColor(SDL_Renderer *renderer, Color color) {
     SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
 }
 
-void line(SDL_Renderer *renderer, Vector2D start, Vector2D end) {
-    SDL_RenderDrawLine(renderer, start.x, start.y, end.x, end.y);
-}
-
-void circle(SDL_Renderer *renderer, Vector2D center, float radius) {
-    int x = radius;
-    int y = 0;
-    int err = 0;
-    while (x >= y) {
-        SDL_RenderDrawPoint(renderer, center.x + x, center.y + y);
-        SDL_RenderDrawPoint(renderer, center.x + y, center.y + x);
-        SDL_RenderDrawPoint(renderer, center.x - y, center.y + x);
-        SDL_RenderDrawPoint(renderer, center.x - x, center.y + y);
-        SDL_RenderDrawPoint(renderer, center.x - x, center.y - y);
-        SDL_RenderDrawPoint(renderer, center.x - y, center.y - x);
-        SDL_RenderDrawPoint(renderer, center.x + y, center.y - x);
-        SDL_RenderDrawPoint(renderer, center.x + x, center.y - y);
-        if (err <= 0) {
-            y += 1;
-            err += 2*y + 1;
-        }
-        if (err > 0) {
-            x -= 1;
-            err -= 2*x + 1;
-        }
-    }
-}
-
-void arrow(SDL_Renderer *renderer, Vector2D start, Vector2D end) {
-    line(renderer, start, end);
-    Vector2D dir = end - start;
-    dir /= dir.magnitude();
-    Vector2D perp = dir.perpendicular();
-    Vector2D arrow1 = end - dir * 10 + perp * 5;
-    Vector2D arrow2 = end - dir * 10 - perp * 5;
-    line(renderer, end, arrow1);
-    line(renderer, end, arrow2);
-}
-
-void cross(SDL_Renderer *renderer, Vector2D center, float radius) {
-    line(renderer, center + Vector2D(-radius, -radius), center + Vector2D(radius, radius));
-    line(renderer, center + Vector2D(-radius, radius), center + Vector2D(radius, -radius));
-}
-
-void rect(SDL_Renderer *renderer, Vector2D topleft, Vector2D bottomright) {
-    SDL_Rect rect;
-    rect.x = topleft.x;
-    rect.y = topleft.y;
-    rect.w = bottomright.x - topleft.x;
-    rect.h = bottomright.y - topleft.y;
-    SDL_RenderDrawRect(renderer, &rect);
-}
-
 void clearScreen(SDL_Renderer *renderer, Color color) {
     setColor(renderer, color);
     SDL_RenderClear(renderer);
@@ -165,13 +131,186 @@ class Drawable;
 /// to determine the order in which objects are drawn.
 class Drawable {
     public:
+        /// @brief How far back the object is drawn.
+        /// @details Objects with a higher depth are drawn first, so objects with
+        /// a lower depth appear on top of them. Only the order between depths
+        /// is guaranteed: primitives of one depth are grouped by type and color
+        /// before they are submitted, so their order among each other is not.
         int depth = 0;
+        /// @brief Whether the object can be drawn on a worker thread, in parallel with other objects.
+        /// @details A camera never draws the same object on two threads at
+        /// once: viewports are recorded one after another, and an object is
+        /// drawn once per viewport. So draw may keep scratch buffers and caches
+        /// of its own in members, and this only requires that it records
+        /// through the camera and that state it shares with other objects,
+        /// like the world or a trajectory engine, is only read or is guarded.
+        /// Objects that create or update textures have to be drawn on the
+        /// thread that renders.
+        bool threadSafe = false;
         /// @brief Draw the object to the screen.
         /// @param camera The camera that is drawing the object.
         /// @details This function is called by the camera to draw the object to the screen.
         virtual void draw(Camera *camera) = 0;
+        /// @brief Get a rectangle in world coordinates that contains everything the object draws.
+        /// @details The camera skips objects whose bounds are out of its view.
+        /// Objects that do not override this are always drawn.
+        virtual Bounds bounds(Camera * /*camera*/) {
+            return Bounds::infinite();
+        }
+        /// @brief Whether the object changed since the camera last drew it.
+        bool dirty = true;
+        /// @brief Mark the object as changed, so that the camera draws it again.
+        /// @details The camera only redraws when the view moved or an object is
+        /// dirty, so an object has to call this whenever what it draws changes.
+        void markDirty() {
+            dirty = true;
+        }
         Drawable();
-        ~Drawable();
+        virtual ~Drawable();
+    private:
+        friend class Camera;
+        /// The cameras the object was added to, so that it can leave them when it is destroyed.
+        std::vector<Camera*> cameras;
+};
+
+/// @brief A range of depths whose objects are rendered into a texture of their own.
+/// @details The texture is kept between frames and only rendered again when an
+/// object in the range is dirty or the view moved. Otherwise the camera just
+/// copies it to the screen.
+struct Layer {
+    /// @brief The lowest depth in the layer.
+    int nearest;
+    /// @brief The highest depth in the layer.
+    int farthest;
+    SDL_Texture *texture = nullptr;
+    RenderQueue queue;
+    bool dirty = true;
+
+    bool contains(int depth) {
+        return depth >= nearest && depth <= farthest;
+    }
+};
+
+/// @brief The state of a thread recording the draw commands of a camera.
+struct Recorder {
+    /// @brief The queue the draw functions record into.
+    RenderQueue *target = nullptr;
+    /// @brief The current draw color, packed.
+    uint32_t color = 0xFFFFFFFF;
+    /// @brief The depth of the drawable being drawn.
+    int depth = 0;
+    /// @brief Screen-space points of the polyline being drawn.
+    std::vector<SDL_FPoint> scratch;
+    /// @brief The queue of a worker, appended to the queue of the camera once all workers are done.
+    RenderQueue queue;
+};
+
+/// @brief A rectangle of the window that shows the scene from its own frame of reference.
+/// @details Every viewport has its own frame, view transformation, visible
+/// bounds and cached layers. The scene, the render queue, the circle atlas and
+/// everything drawables cache in world coordinates are shared by all viewports
+/// of a camera, so an extra view only repeats the transformation to the
+/// screen and the culling.
+class Viewport {
+    public:
+        /// @brief The position of the viewport in the window, in pixels.
+        int x, y;
+        /// @brief The size of the viewport, in pixels.
+        int width, height;
+        /// @brief Whether the viewport is drawn.
+        bool shown = true;
+        /// @brief The body whose frame the viewport shows, or -1 for the world frame.
+        /// @details The camera only moves with its frame. Drawables read this to
+        /// decide what to draw relative to.
+        int reference = -1;
+        /// @brief Whether the viewport shows the co-rotating frame. Drawables read this as well.
+        bool corotating = false;
+        /// @brief The frame the viewport shows, if it is set with a Frame2D.
+        Frame2D *frame = nullptr;
+        /// @brief The frame the viewport shows, if it is set with a FrameNode. Only one of the two is set.
+        FrameNode *node = nullptr;
+        /// @brief The transformation from world coordinates to pixels of the viewport, composed once per render.
+        Affine2D view;
+        /// @brief The part of the world that is in the viewport.
+        Bounds visible;
+        /// @brief The cached layers, created by the camera.
+        std::vector<Layer> layers;
+        /// @brief The view the layers were last recorded with.
+        Affine2D presented;
+        bool hasPresented = false;
+
+        /// @brief Create a viewport.
+        /// @param x The left edge in the window, in pixels.
+        /// @param y The top edge in the window, in pixels.
+        /// @param width The width, in pixels.
+        /// @param height The height, in pixels.
+        Viewport(int x, int y, int width, int height) {
+            this->x = x;
+            this->y = y;
+            this->width = width;
+            this->height = height;
+        }
+
+        Viewport(const Viewport&) = delete;
+        Viewport& operator=(const Viewport&) = delete;
+
+        ~Viewport() {
+            destroyLayers();
+        }
+
+        /// @brief Move and resize the viewport.
+        void setRect(int x, int y, int width, int height) {
+            if (width != this->width || height != this->height) destroyLayers();
+            this->x = x;
+            this->y = y;
+            this->width = width;
+            this->height = height;
+            invalidate();
+        }
+
+        /// @brief Make the camera draw the viewport again, for example after changing what it shows.
+        void invalidate() {
+            hasPresented = false;
+            for (int l = 0; l < layers.size(); l++) {
+                layers[l].dirty = true;
+            }
+        }
+
+        /// @brief Check whether the view moved by at least a pixel since the layers were last recorded.
+        /// @details The transformations are affine, so it is enough to check
+        /// how far the corners of the viewport moved.
+        bool moved() {
+            if (!hasPresented) return true;
+            Affine2D back = presented.inverse();
+            for (int corner = 0; corner < 4; corner++) {
+                Vector2D p((corner & 1) * width, (corner >> 1) * height);
+                if ((view.apply(back.apply(p)) - p).magnitude() >= 1) return true;
+            }
+            return false;
+        }
+
+        void destroyLayers() {
+            for (int l = 0; l < layers.size(); l++) {
+                SDL_DestroyTexture(layers[l].texture);
+            }
+            layers.clear();
+        }
+
+        /// @brief Recompose the transformation from world coordinates to pixels and the visible bounds.
+        void updateView() {
+            Affine2D local;
+            if (node != nullptr) local = node->getMatrix();
+            else if (frame != nullptr) local = Affine2D::fromFrame(frame);
+            local.tx += width / 2;
+            local.ty += height / 2;
+            view = local;
+            Affine2D inverse = view.inverse();
+            visible = Bounds();
+            visible.expand(inverse.apply(Vector2D(0, 0)));
+            visible.expand(inverse.apply(Vector2D(width, 0)));
+            visible.expand(inverse.apply(Vector2D(0, height)));
+            visible.expand(inverse.apply(Vector2D(width, height)));
+        }
 };
 
 /// @brief A class that represents a camera.
@@ -180,10 +319,160 @@ class Camera {
     private:
         SDL_Renderer* renderer;
         SDL_Window* window;
-        static std::vector<Drawable*> drawables;
+        /// The objects drawn by this camera.
+        Scene scene;
         static int cameras;
-        Frame2D* frame = nullptr;
-        Vector2D center;
+        std::vector<std::unique_ptr<Viewport>> viewports;
+        /// The viewport being drawn, or the first one outside of render.
+        Viewport *current;
+        /// The view and size of the current viewport, copied for the draw functions.
+        Affine2D view;
+        Bounds visible;
+        int width;
+        int height;
+        int windowWidth;
+        int windowHeight;
+        /// The primitives recorded during the current render.
+        RenderQueue queue;
+        /// The depth ranges of the layers every viewport keeps.
+        std::vector<Layer> layerRanges;
+        /// The recording state of the thread that renders.
+        Recorder main;
+        /// The recording states of the chunks drawn in parallel.
+        std::vector<std::unique_ptr<Recorder>> workers;
+        /// The recording state of a worker while it draws for a camera, or nullptr.
+        inline static thread_local Recorder *active = nullptr;
+        /// The visible thread-safe drawables of the layer being recorded, with their depths.
+        std::vector<std::pair<Drawable*, int>> parallel;
+        /// Outlines of circles, drawn as sprites.
+        CircleAtlas atlas;
+
+        static SDL_FPoint point(Vector2D p) {
+            SDL_FPoint result;
+            result.x = p.x;
+            result.y = p.y;
+            return result;
+        }
+
+        /// Get the recording state of the calling thread.
+        Recorder &recorder() {
+            return active != nullptr ? *active : main;
+        }
+
+        void line(Vector2D start, Vector2D end) {
+            Recorder &state = recorder();
+            state.target->line(point(start), point(end), state.color, state.depth);
+        }
+
+        /// Record a circle in screen space.
+        void circle(SDL_FPoint c, float r, uint32_t color) {
+            Recorder &state = recorder();
+            if (r < 1) {
+                state.target->point(c, color, state.depth);
+                return;
+            }
+            int sprite = atlas.find(r);
+            if (sprite < 0) {
+                state.target->circle(c, r, color, state.depth);
+                return;
+            }
+            state.target->sprite(atlas.texture, atlas.destination(sprite, c, r), atlas.sprites[sprite].source,
+                                 color, state.depth);
+        }
+
+        /// Record an arrow in screen space.
+        void arrow(Vector2D from, Vector2D to, uint32_t color) {
+            Recorder &state = recorder();
+            state.target->line(point(from), point(to), color, state.depth);
+            Vector2D dir = to - from;
+            float length = dir.magnitude();
+            if (length == 0) return;
+            dir /= length;
+            Vector2D perp = dir.perpendicular();
+            state.target->line(point(to), point(to - dir * 10 + perp * 5), color, state.depth);
+            state.target->line(point(to), point(to - dir * 10 - perp * 5), color, state.depth);
+        }
+
+        /// Make a viewport the one the draw functions draw into.
+        void use(Viewport *viewport) {
+            current = viewport;
+            view = viewport->view;
+            visible = viewport->visible;
+            width = viewport->width;
+            height = viewport->height;
+        }
+
+        /// Create the layer textures of a viewport that do not exist yet.
+        void createLayers(Viewport *viewport) {
+            if (viewport->layers.size() == layerRanges.size()) return;
+            viewport->destroyLayers();
+            for (int l = 0; l < layerRanges.size(); l++) {
+                Layer layer;
+                layer.nearest = layerRanges[l].nearest;
+                layer.farthest = layerRanges[l].farthest;
+                layer.texture = createTarget(viewport->width, viewport->height);
+                layer.queue.viewport = {0, 0, (float)viewport->width, (float)viewport->height};
+                viewport->layers.push_back(layer);
+            }
+        }
+
+        /// Record the visible objects of a layer, or of no layer if it is -1, into a queue.
+        /// Objects that are not thread-safe are drawn right away, and the
+        /// thread-safe ones are collected and drawn in parallel afterwards.
+        void record(RenderQueue &into, int layer) {
+            main.target = &into;
+            parallel.clear();
+            for (auto &bucket : scene.buckets) {
+                if (findLayer(bucket.first) != layer) continue;
+                std::vector<Drawable*> &drawables = bucket.second;
+                for (int i = 0; i < drawables.size(); i++) {
+                    if (!isVisible(drawables[i]->bounds(this))) continue;
+                    if (drawables[i]->threadSafe) {
+                        parallel.push_back({drawables[i], bucket.first});
+                        continue;
+                    }
+                    main.depth = bucket.first;
+                    drawables[i]->draw(this);
+                }
+            }
+            recordParallel(into);
+            main.target = &queue;
+        }
+
+        /// Draw the collected thread-safe objects on the shared thread pool.
+        /// The objects are split into one chunk per thread, and every chunk
+        /// records into a queue of its own, so the workers never share a
+        /// buffer. The queues are appended to the target queue in one pass
+        /// once all chunks are done; submission stays on the calling thread.
+        void recordParallel(RenderQueue &into) {
+            int n = parallel.size();
+            ThreadPool &pool = ThreadPool::global();
+            int chunks = std::min(n, pool.size() + 1);
+            if (chunks <= 1) {
+                for (int i = 0; i < n; i++) {
+                    main.depth = parallel[i].second;
+                    parallel[i].first->draw(this);
+                }
+                return;
+            }
+            while (workers.size() < chunks) workers.push_back(std::make_unique<Recorder>());
+            pool.parallelFor(0, chunks, [this, &into, n, chunks](int c) {
+                Recorder &worker = *workers[c];
+                worker.queue.clear();
+                worker.queue.viewport = into.viewport;
+                worker.target = &worker.queue;
+                Recorder *previous = active;
+                active = &worker;
+                for (int i = n * c / chunks; i < n * (c + 1) / chunks; i++) {
+                    worker.depth = parallel[i].second;
+                    parallel[i].first->draw(this);
+                }
+                active = previous;
+            });
+            for (int c = 0; c < chunks; c++) {
+                into.append(workers[c]->queue);
+            }
+        }
     public:
         /// @brief Create a camera.
         /// @param name The name of the window.
@@ -198,73 +487,316 @@ class Camera {
                     SDL_WINDOWPOS_UNDEFINED,
                     width, height,
                     SDL_WINDOW_OPENGL);
-            renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
-            center = Vector2D(width / 2, height / 2);
+            renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_TARGETTEXTURE);
+            atlas.create(renderer);
+            windowWidth = width;
+            windowHeight = height;
+            main.target = &queue;
             cameras += 1;
-            this->frame = frame;
+            Viewport *viewport = addViewport(0, 0, width, height);
+            viewport->frame = frame;
+            viewport->updateView();
+            use(viewport);
         }
 
         ~Camera() {
-            SDL_DestroyWindow(window);
+            for (auto &bucket : scene.buckets) {
+                std::vector<Drawable*> &drawables = bucket.second;
+                for (int i = 0; i < drawables.size(); i++) {
+                    std::vector<Camera*> &owners = drawables[i]->cameras;
+                    owners.erase(std::remove(owners.begin(), owners.end(), this), owners.end());
+                }
+            }
+            atlas.destroy();
+            viewports.clear();
             SDL_DestroyRenderer(renderer);
+            SDL_DestroyWindow(window);
             cameras -= 1;
             if (cameras == 0) SDL_Quit();
         }
 
-        /// @brief Add a drawable object to the pool of objects to be drawn.
-        /// @param drawable The drawable object to be added.
-        /// @details This function adds a drawable object to the pool of objects to be drawn. The object will be drawn in the order of its depth value.
-        static void addDrawable(Drawable* drawable) {
-            if (drawables.size() == 0) drawables.push_back(drawable);
-            for (int i = 0; i < drawables.size(); i++) {
-                if (drawables[i]->depth > drawable->depth) {
-                    drawables.insert(drawables.begin() + i, drawable);
-                    return;
-                }
+        /// @brief Get the index of the layer a depth belongs to, or -1 if it belongs to none.
+        int findLayer(int depth) {
+            for (int l = 0; l < layerRanges.size(); l++) {
+                if (layerRanges[l].contains(depth)) return l;
             }
+            return -1;
         }
 
-        /// @brief Remove a drawable object from the pool of objects to be drawn.
+        /// @brief Add a viewport to the window.
+        /// @param x The left edge in the window, in pixels.
+        /// @param y The top edge in the window, in pixels.
+        /// @param width The width, in pixels.
+        /// @param height The height, in pixels.
+        /// @return The viewport, owned by the camera.
+        Viewport *addViewport(int x, int y, int width, int height) {
+            viewports.push_back(std::make_unique<Viewport>(x, y, width, height));
+            return viewports.back().get();
+        }
+
+        /// @brief Get a viewport by index. The first viewport is created with the camera.
+        Viewport *getViewport(int index) {
+            return viewports[index].get();
+        }
+
+        /// @brief Get the viewport being drawn, or the first viewport outside of render.
+        Viewport *getViewport() {
+            return current;
+        }
+
+        /// @brief Get the number of viewports.
+        int getViewportCount() {
+            return viewports.size();
+        }
+
+        /// @brief Add a drawable object to the objects drawn by this camera.
+        /// @param drawable The drawable object to be added.
+        /// @details The object is drawn in the order of its depth value, which
+        /// must be set before it is added. An object can be added to several
+        /// cameras, and it leaves all of them when it is destroyed.
+        void addDrawable(Drawable* drawable) {
+            if (!scene.add(drawable, drawable->depth)) return;
+            drawable->cameras.push_back(this);
+            drawable->markDirty();
+        }
+
+        /// @brief Remove a drawable object from the objects drawn by this camera.
         /// @param drawable The drawable object to be removed.
-        /// @details This function removes a drawable object from the pool of objects to be drawn.
-        static void removeDrawable(Drawable* drawable) {
-            for (int i = 0; i < drawables.size(); i++) {
-                if (drawables[i] == drawable) {
-                    drawables.erase(drawables.begin() + i);
-                    return;
-                }
+        void removeDrawable(Drawable* drawable) {
+            if (!scene.remove(drawable)) return;
+            std::vector<Camera*> &owners = drawable->cameras;
+            owners.erase(std::remove(owners.begin(), owners.end(), this), owners.end());
+            // The object may have covered something, so the next frame has to be drawn.
+            for (int v = 0; v < viewports.size(); v++) {
+                viewports[v]->invalidate();
             }
         }
 
         /// @brief Set the frame of reference for the camera.
         /// @param frame The frame of reference for the camera.
-        /// @details This function sets the frame of reference for the camera. The camera will draw objects in the frame of reference of this frame.
+        /// @details This function sets the frame of reference of the current viewport. The camera will draw objects in the frame of reference of this frame.
         void setFrame(Frame2D* frame) {
-            this->frame = frame;
+            current->frame = frame;
+            current->node = nullptr;
+            updateView();
+        }
+
+        /// @brief Set the frame of reference for the camera.
+        /// @param node The frame of reference for the camera.
+        /// @details The transformation of a FrameNode is cached by the node itself, so it is only recomposed when the frame moves.
+        void setFrame(FrameNode* node) {
+            current->node = node;
+            current->frame = nullptr;
+            updateView();
+        }
+
+        /// @brief Recompose the transformation from world coordinates to pixels of the current viewport.
+        /// @details This is done at the start of every render, so the frame is
+        /// walked once per frame instead of once per drawn point.
+        void updateView() {
+            current->updateView();
+            use(current);
+        }
+
+        /// @brief Get the rectangle in world coordinates that contains the view.
+        /// @details For a rotated view this is larger than the view itself.
+        const Bounds &getVisibleBounds() {
+            return visible;
+        }
+
+        /// @brief Check whether anything inside a rectangle in world coordinates can be on the screen.
+        bool isVisible(const Bounds &bounds) {
+            return visible.intersects(bounds);
+        }
+
+        /// @brief Get the transformation from world coordinates to pixels.
+        const Affine2D &getView() {
+            return view;
+        }
+
+        /// @brief Get the screen coordinates of a point.
+        /// @param point The point in world coordinates.
+        /// @return The position of the point on the screen, in pixels.
+        Vector2D toScreen(Vector2D point) {
+            return view.apply(point);
+        }
+
+        /// @brief Get the world coordinates of a point on the screen.
+        /// @param point The position on the screen, in pixels.
+        /// @return The point in world coordinates.
+        Vector2D toWorld(Vector2D point) {
+            return view.inverse().apply(point);
+        }
+
+        /// @brief Get the width of the current viewport.
+        int getWidth() {
+            return width;
+        }
+
+        /// @brief Get the height of the current viewport.
+        int getHeight() {
+            return height;
+        }
+
+        /// @brief Get the width of the window.
+        int getWindowWidth() {
+            return windowWidth;
+        }
+
+        /// @brief Get the height of the window.
+        int getWindowHeight() {
+            return windowHeight;
+        }
+
+        /// @brief Create a texture that can be drawn by this camera.
+        /// @param width The width of the texture.
+        /// @param height The height of the texture.
+        /// @return A texture with 32-bit RGBA pixels. It has to be destroyed with SDL_DestroyTexture.
+        SDL_Texture* createTexture(int width, int height) {
+            SDL_Texture *texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888,
+                    SDL_TEXTUREACCESS_STATIC, width, height);
+            SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+            return texture;
+        }
+
+        /// @brief Create a texture that can be drawn into.
+        /// @param width The width of the texture.
+        /// @param height The height of the texture.
+        /// @return A texture with 32-bit RGBA pixels. It has to be destroyed with SDL_DestroyTexture.
+        SDL_Texture* createTarget(int width, int height) {
+            SDL_Texture *texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888,
+                    SDL_TEXTUREACCESS_TARGET, width, height);
+            SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+            return texture;
         }
 
-        /// @brief Get the frame of reference for the camera.
-        /// @return The frame of reference for the camera.
-        Frame2D* getFrame() {
-            return frame;
+        /// @brief Clear a texture and draw recorded primitives into it right away.
+        /// @param target A texture created with createTarget.
+        /// @param primitives The primitives, in pixels of the texture.
+        void renderToTexture(SDL_Texture *target, RenderQueue &primitives) {
+            SDL_Texture *previous = SDL_GetRenderTarget(renderer);
+            SDL_SetRenderTarget(renderer, target);
+            SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+            SDL_RenderClear(renderer);
+            primitives.flush(renderer);
+            SDL_SetRenderTarget(renderer, previous);
+        }
+
+        /// @brief Draw a texture in screen space.
+        /// @param texture The texture to draw.
+        /// @param topleft The top left corner of the texture on the screen, in pixels.
+        /// @param size The size of the texture on the screen, in pixels.
+        void drawTexture(SDL_Texture *texture, Vector2D topleft, Vector2D size) {
+            SDL_FRect rect;
+            rect.x = topleft.x;
+            rect.y = topleft.y;
+            rect.w = size.x;
+            rect.h = size.y;
+            Recorder &state = recorder();
+            state.target->texture(texture, rect, state.depth);
+        }
+
+        /// @brief Render the objects with depths in a range into a cached texture of their own.
+        /// @param nearest The lowest depth in the layer.
+        /// @param farthest The highest depth in the layer.
+        /// @details Use this for objects that change rarely, like backgrounds.
+        /// Ranges of layers must not overlap.
+        void addLayer(int nearest, int farthest) {
+            Layer layer;
+            layer.nearest = nearest;
+            layer.farthest = farthest;
+            layerRanges.push_back(layer);
         }
 
         /// @brief Draw all objects to the screen.
-        /// @details This function draws all objects to the screen.
-        /// @todo Make this function only draw objects that are in the camera's view.
-        void render() {
+        /// @details Drawables only record their primitives into a command
+        /// buffer. Once all of them are recorded, the buffer is submitted to
+        /// SDL in a few large batches.
+        /// Objects whose bounds are out of the view are not drawn at all.
+        ///
+        /// Nothing is drawn if no view moved by a pixel and no object is dirty,
+        /// so a paused simulation costs almost nothing. Otherwise only the
+        /// layers with dirty objects or in a moved viewport and the objects
+        /// outside of layers are recorded again, and clean layers are copied from
+        /// their textures. Every shown viewport is recorded and submitted in
+        /// turn, clipped to its rectangle of the window.
+        /// @return Whether a new frame was presented.
+        bool render() {
+            bool changed = false;
+            for (int v = 0; v < viewports.size(); v++) {
+                Viewport *viewport = viewports[v].get();
+                if (!viewport->shown) continue;
+                viewport->updateView();
+                createLayers(viewport);
+                // Views that moved by less than a pixel keep their layers, and
+                // the drift is measured from the view the layers were recorded with.
+                bool moved = viewport->moved();
+                if (moved) {
+                    viewport->presented = viewport->view;
+                    viewport->hasPresented = true;
+                }
+                for (int l = 0; l < viewport->layers.size(); l++) {
+                    viewport->layers[l].dirty = viewport->layers[l].dirty || moved;
+                }
+                changed = changed || moved;
+            }
+            for (auto &bucket : scene.buckets) {
+                std::vector<Drawable*> &drawables = bucket.second;
+                for (int i = 0; i < drawables.size(); i++) {
+                    if (!drawables[i]->dirty) continue;
+                    changed = true;
+                    int l = findLayer(bucket.first);
+                    for (int v = 0; l >= 0 && v < viewports.size(); v++) {
+                        if (l < viewports[v]->layers.size()) viewports[v]->layers[l].dirty = true;
+                    }
+                    break;
+                }
+            }
+            if (!changed) return false;
+
+            SDL_RenderSetViewport(renderer, NULL);
             draw::clearScreen(renderer, Color::black());
-            for (int i = 0; i < drawables.size(); i++) {
-                drawables[i]->draw(this);
+            for (int v = 0; v < viewports.size(); v++) {
+                Viewport *viewport = viewports[v].get();
+                if (!viewport->shown) continue;
+                use(viewport);
+                for (int l = 0; l < viewport->layers.size(); l++) {
+                    Layer &layer = viewport->layers[l];
+                    if (!layer.dirty) continue;
+                    layer.queue.clear();
+                    record(layer.queue, l);
+                    renderToTexture(layer.texture, layer.queue);
+                    layer.dirty = false;
+                }
+                queue.clear();
+                queue.viewport = {0, 0, (float)width, (float)height};
+                record(queue, -1);
+                for (int l = 0; l < viewport->layers.size(); l++) {
+                    queue.texture(viewport->layers[l].texture, {0, 0, (float)width, (float)height},
+                                  viewport->layers[l].farthest);
+                }
+                SDL_Rect rect = {viewport->x, viewport->y, viewport->width, viewport->height};
+                SDL_RenderSetViewport(renderer, &rect);
+                queue.flush(renderer);
+                SDL_RenderSetViewport(renderer, NULL);
             }
             SDL_RenderPresent(renderer);
+            use(viewports[0].get());
+
+            for (auto &bucket : scene.buckets) {
+                std::vector<Drawable*> &drawables = bucket.second;
+                for (int i = 0; i < drawables.size(); i++) {
+                    drawables[i]->dirty = false;
+                }
+            }
+            return true;
         }
 
         /// @brief Set the color that will be used to draw objects.
         /// @param color The color that will be used to draw objects.
         /// @details This function sets the color that will be used to draw objects.
         void setDrawColor(Color color) {
-            draw::setColor(renderer, color);
+            recorder().color = color.packed();
         }
 
         /// @brief Draw a line.
@@ -272,19 +804,122 @@ class Camera {
         /// @param end The end point of the line.
         /// @details This function draws a line from the start point to the end point.
         void drawLine(Vector2D start, Vector2D end) {
-            draw::line(renderer,
-                    center + frame->getLocalCoordinates(start),
-                    center + frame->getLocalCoordinates(end));
+            line(view.apply(start), view.apply(end));
+        }
+
+        /// @brief Transform a batch of world points to the screen.
+        /// @param points The points in world coordinates.
+        /// @param n The number of points.
+        /// @param out Set to the positions of the points on the screen, in pixels.
+        void transformPoints(const Vector2D *points, int n, SDL_FPoint *out) {
+            view.transform(points, &out->x, n);
+        }
+
+        /// @brief Transform a batch of world points, stored as coordinate arrays, to the screen.
+        /// @param x The x coordinates of the points.
+        /// @param y The y coordinates of the points.
+        /// @param n The number of points.
+        /// @param out Set to the positions of the points on the screen, in pixels.
+        /// @param offset Added to every point before transforming it.
+        void transformPoints(const float *x, const float *y, int n, SDL_FPoint *out, Vector2D offset = Vector2D(0, 0)) {
+            view.transform(x, y, &out->x, n, offset.x, offset.y);
+        }
+
+        /// @brief Draw a polyline.
+        /// @param points The vertices of the polyline, in world coordinates.
+        /// @param closed Whether to connect the last vertex back to the first.
+        /// @details All vertices are transformed in one batch and drawn with a single call.
+        void drawPolyline(const std::vector<Vector2D> &points, bool closed = false) {
+            int n = points.size();
+            if (n < 2) return;
+            Recorder &state = recorder();
+            state.scratch.resize(n);
+            transformPoints(points.data(), n, state.scratch.data());
+            state.target->polyline(state.scratch.data(), n, closed, state.color, state.depth);
+        }
+
+        /// @brief Draw a polyline whose vertices are stored as coordinate arrays.
+        /// @param x The x coordinates of the vertices, in world coordinates.
+        /// @param y The y coordinates of the vertices, in world coordinates.
+        /// @param n The number of vertices.
+        /// @param offset Added to every vertex.
+        /// @param closed Whether to connect the last vertex back to the first.
+        void drawPolyline(const float *x, const float *y, int n, Vector2D offset = Vector2D(0, 0), bool closed = false) {
+            if (n < 2) return;
+            Recorder &state = recorder();
+            state.scratch.resize(n);
+            transformPoints(x, y, n, state.scratch.data(), offset);
+            state.target->polyline(state.scratch.data(), n, closed, state.color, state.depth);
+        }
+
+        /// @brief Draw the visible parts of a polyline whose vertices are stored as coordinate arrays.
+        /// @param x The x coordinates of the vertices, in world coordinates.
+        /// @param y The y coordinates of the vertices, in world coordinates.
+        /// @param n The number of vertices.
+        /// @param chunks The bounds of chunks of the polyline, before the offset.
+        /// @param offset Added to every vertex.
+        /// @param closed Whether to connect the last vertex back to the first.
+        /// @details Chunks out of the view are skipped, and every run of
+        /// visible chunks is drawn as a separate polyline.
+        void drawPolyline(const float *x, const float *y, int n, const ChunkBounds &chunks,
+                          Vector2D offset = Vector2D(0, 0), bool closed = false) {
+            if (n < 2 || !isVisible(chunks.total.translated(offset))) return;
+            int count = chunks.chunks.size();
+            int c = 0;
+            bool all = true;
+            while (c < count) {
+                if (!isVisible(chunks.chunks[c].translated(offset))) {
+                    all = false;
+                    c++;
+                    continue;
+                }
+                int end = c + 1;
+                while (end < count && isVisible(chunks.chunks[end].translated(offset))) end++;
+                int first = c * chunks.size;
+                int last = std::min(end * chunks.size, n - 1);
+                if (c == 0 && end == count) {
+                    drawPolyline(x, y, n, offset, closed);
+                    return;
+                }
+                drawPolyline(x + first, y + first, last - first + 1, offset);
+                c = end;
+            }
+            if (closed && !all) {
+                Bounds closing;
+                closing.expand(x[0], y[0]);
+                closing.expand(x[n - 1], y[n - 1]);
+                if (isVisible(closing.translated(offset))) {
+                    drawLine(Vector2D(x[n - 1], y[n - 1]) + offset, Vector2D(x[0], y[0]) + offset);
+                }
+            }
         }
 
         /// @brief Draw a circle.
         /// @param center The center of the circle.
         /// @param radius The radius of the circle.
-        /// @details This function draws a circle with the given center and radius.
+        /// @details Circles are drawn as tinted sprites from the circle atlas,
+        /// so any number of them costs one batch. Circles smaller than a pixel
+        /// are drawn as a single point, and circles too large for the atlas
+        /// are drawn as polylines over the arc that can be in the viewport.
         void drawCircle(Vector2D center, float radius) {
-            draw::circle(renderer,
-                    this->center + frame->getLocalCoordinates(center),
-                    frame->getScale().x * radius);
+            circle(point(view.apply(center)), view.scale() * radius, recorder().color);
+        }
+
+        /// @brief Draw a batch of circles.
+        /// @param x The x coordinates of the centers.
+        /// @param y The y coordinates of the centers.
+        /// @param radius The radii.
+        /// @param colors The colors, packed as by Color::packed.
+        /// @param n The number of circles.
+        /// @details The centers are transformed to the screen in one pass.
+        void drawCircles(const float *x, const float *y, const float *radius, const uint32_t *colors, int n) {
+            std::vector<SDL_FPoint> &scratch = recorder().scratch;
+            scratch.resize(n);
+            transformPoints(x, y, n, scratch.data());
+            float scale = view.scale();
+            for (int i = 0; i < n; i++) {
+                circle(scratch[i], scale * radius[i], colors[i]);
+            }
         }
 
         /// @brief Draw an arrow.
@@ -292,9 +927,28 @@ class Camera {
         /// @param end The end point of the arrow.
         /// @details This function draws an arrow from the start point to the end point.
         void drawArrow(Vector2D start, Vector2D end) {
-            draw::arrow(renderer,
-                    center + frame->getLocalCoordinates(start),
-                    center + frame->getLocalCoordinates(end));
+            arrow(view.apply(start), view.apply(end), recorder().color);
+        }
+
+        /// @brief Draw a batch of arrows.
+        /// @param x The x coordinates of the start points.
+        /// @param y The y coordinates of the start points.
+        /// @param dx The x offsets from the start points to the end points.
+        /// @param dy The y offsets from the start points to the end points.
+        /// @param colors The colors, packed as by Color::packed.
+        /// @param n The number of arrows.
+        /// @details The start points are transformed to the screen in one pass,
+        /// and the offsets only by the linear part of the view.
+        void drawArrows(const float *x, const float *y, const float *dx, const float *dy, const uint32_t *colors, int n) {
+            std::vector<SDL_FPoint> &scratch = recorder().scratch;
+            scratch.resize(n);
+            transformPoints(x, y, n, scratch.data());
+            float a = view.a, b = view.b, c = view.c, d = view.d;
+            for (int i = 0; i < n; i++) {
+                Vector2D from(scratch[i].x, scratch[i].y);
+                Vector2D offset(a * dx[i] + b * dy[i], c * dx[i] + d * dy[i]);
+                arrow(from, from + offset, colors[i]);
+            }
         }
 
         /// @brief Draw a cross.
@@ -302,9 +956,10 @@ class Camera {
         /// @param radius The radius of the cross.
         /// @details This function draws a cross with the given center and radius.
         void drawCross(Vector2D center, float radius) {
-            draw::cross(renderer,
-                    this->center + frame->getLocalCoordinates(center),
-                    frame->getScale().x * radius);
+            Vector2D c = view.apply(center);
+            float r = view.scale() * radius;
+            line(c + Vector2D(-r, -r), c + Vector2D(r, r));
+            line(c + Vector2D(-r, r), c + Vector2D(r, -r));
         }
 
         /// @brief Draw a rectangle.
@@ -312,21 +967,25 @@ class Camera {
         /// @param bottomright The bottom right corner of the rectangle.
         /// @details This function draws a rectangle with the given top left and bottom right corners.
         void drawRect(Vector2D topleft, Vector2D bottomright) {
-            draw::rect(renderer,
-                    this->center + frame->getLocalCoordinates(topleft),
-                    this->center + frame->getLocalCoordinates(bottomright));
+            Vector2D a = view.apply(topleft);
+            Vector2D b = view.apply(bottomright);
+            line(a, Vector2D(b.x, a.y));
+            line(Vector2D(b.x, a.y), b);
+            line(b, Vector2D(a.x, b.y));
+            line(Vector2D(a.x, b.y), a);
         }
 };
 
-std::vector<Drawable*> Camera::drawables = std::vector<Drawable*>();
 int Camera::cameras = 0;
 
 Drawable::Drawable() {
-    Camera::addDrawable(this);
 }
 
 Drawable::~Drawable() {
-    Camera::removeDrawable(this);
+    // Removing the object from a camera also removes the camera from the list.
+    while (!cameras.empty()) {
+        cameras.back()->removeDrawable(this);
+    }
 }
 
 #endif
\ No newline at end of file
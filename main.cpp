@@ -2,7 +2,21 @@
 #include "Vector2D.h"
 #include "graphics.h"
 #include "Frame2D.h"
+#include "collision.h"
+#include "prediction.h"
+#include "ephemeris.h"
+#include "tessellation.h"
+#include "relative.h"
+#include "corotating.h"
+#include "potential.h"
+#include "components.h"
+#include "simulation.h"
 #include <iostream>
+#include <memory>
+#include <unordered_map>
+#include <map>
+#include <cstring>
+#include <cstdlib>
 #include <SDL2/SDL.h>
 #define PRINT(x) std::cout << #x << " = " << x << std::endl
 #define PI 3.14159265358979323846
@@ -14,147 +28,539 @@ void initWorld(PhysicsWorld &world) {
     world.addBody(PhysicsBody(Vector2D(320, 60), Vector2D(-400, 0), 1));
 }
 
-// Class extenting drawable used to draw a physics body
-class BodyDrawable : public Drawable {
+// Function to find the index a body has after merges, given the index every
+// initial body had before and has after them, or -1 if the body is unknown
+int remapBody(int body, const std::vector<int> &before, const std::vector<int> &after) {
+    if (body < 0) return body;
+    for (int i = 0; i < before.size(); i++) {
+        if (before[i] == body) return after[i];
+    }
+    return -1;
+}
+
+// Class extending drawable used to draw an infinite background grid. Only the
+// lines in view are computed, with a spacing picked by the zoom, and every
+// tenth line is brighter. The grid is drawn into a texture larger than the
+// window by a margin, which is reused while the view pans within the margin
+// and zooms or rotates by less than the threshold. Every viewport has its own texture
+class GridDrawable : public Drawable {
     private:
-        PhysicsBody *body;
+        struct Cache {
+            SDL_Texture *texture = nullptr;
+            int textureWidth;
+            int textureHeight;
+            Affine2D cached;
+        };
+        float spacing;
+        std::unordered_map<Viewport*, Cache> caches;
+        RenderQueue queue;
+        // Check whether the texture still covers the viewport and is close enough to the view
+        bool covers(Camera *camera, const Cache &cache, const Affine2D &change) {
+            if (cache.texture == nullptr) return false;
+            if (cache.textureWidth != camera->getWidth() + 2 * margin ||
+                cache.textureHeight != camera->getHeight() + 2 * margin) return false;
+            if (std::fabs(change.a - 1) > threshold || std::fabs(change.d - 1) > threshold ||
+                std::fabs(change.b) > threshold || std::fabs(change.c) > threshold) return false;
+            Vector2D topleft = change.apply(Vector2D(-margin, -margin));
+            Vector2D bottomright = change.apply(Vector2D(camera->getWidth() + margin, camera->getHeight() + margin));
+            return topleft.x <= 0 && topleft.y <= 0 &&
+                   bottomright.x >= camera->getWidth() && bottomright.y >= camera->getHeight();
+        }
+        void redraw(Camera *camera, Cache &cache, const Affine2D &view) {
+            int textureWidth = camera->getWidth() + 2 * margin;
+            int textureHeight = camera->getHeight() + 2 * margin;
+            if (cache.texture == nullptr || cache.textureWidth != textureWidth || cache.textureHeight != textureHeight) {
+                if (cache.texture != nullptr) SDL_DestroyTexture(cache.texture);
+                cache.texture = camera->createTarget(textureWidth, textureHeight);
+                cache.textureWidth = textureWidth;
+                cache.textureHeight = textureHeight;
+            }
+            float step = spacing;
+            float pixels = view.scale();
+            while (step * pixels < minimumPixels) step *= 10;
+            while (step * pixels >= minimumPixels * 10) step /= 10;
+            Affine2D toTexture = view;
+            toTexture.tx += margin;
+            toTexture.ty += margin;
+            Affine2D toWorld = toTexture.inverse();
+            Bounds region;
+            region.expand(toWorld.apply(Vector2D(0, 0)));
+            region.expand(toWorld.apply(Vector2D(textureWidth, 0)));
+            region.expand(toWorld.apply(Vector2D(0, textureHeight)));
+            region.expand(toWorld.apply(Vector2D(textureWidth, textureHeight)));
+            uint32_t minor = Color(32, 32, 32).packed();
+            uint32_t major = Color::darkGray().packed();
+            queue.clear();
+            queue.viewport = {0, 0, (float)textureWidth, (float)textureHeight};
+            for (long long k = std::ceil(region.min.x / step); k * step <= region.max.x; k++) {
+                Vector2D a = toTexture.apply(Vector2D(k * step, region.min.y));
+                Vector2D b = toTexture.apply(Vector2D(k * step, region.max.y));
+                queue.line({a.x, a.y}, {b.x, b.y}, k % 10 == 0 ? major : minor, 0);
+            }
+            for (long long k = std::ceil(region.min.y / step); k * step <= region.max.y; k++) {
+                Vector2D a = toTexture.apply(Vector2D(region.min.x, k * step));
+                Vector2D b = toTexture.apply(Vector2D(region.max.x, k * step));
+                queue.line({a.x, a.y}, {b.x, b.y}, k % 10 == 0 ? major : minor, 0);
+            }
+            camera->renderToTexture(cache.texture, queue);
+            cache.cached = view;
+        }
     public:
-        BodyDrawable(PhysicsBody *body) {
-            this->body = body;
-            this->depth = 1;
+        // The smallest distance between two lines on the screen, in pixels
+        float minimumPixels = 25;
+        // How far the view can pan before the texture is redrawn, in pixels
+        int margin = 256;
+        // How much the view can zoom or rotate before the texture is redrawn
+        float threshold = 0.02;
+        GridDrawable(float spacing) {
+            this->spacing = spacing;
+            this->depth = 10;
+        }
+        ~GridDrawable() {
+            for (auto &entry : caches) {
+                if (entry.second.texture != nullptr) SDL_DestroyTexture(entry.second.texture);
+            }
         }
         void draw(Camera *camera) {
-            Vector2D position = body->getPosition();
-            float radius = body->getMass();
-            camera->setDrawColor(Color::white());
-            camera->drawCircle(position, radius);
-            camera->setDrawColor(Color::red());
-            camera->drawArrow(position, position + body->getVelocity());
+            const Affine2D &view = camera->getView();
+            if (!(view.scale() > 0)) return;
+            Cache &cache = caches[camera->getViewport()];
+            // From pixels of the view the texture was drawn for to pixels of the current view
+            Affine2D change = cache.cached.inverse().then(view);
+            if (!covers(camera, cache, change)) {
+                redraw(camera, cache, view);
+                change = Affine2D::identity();
+            }
+            Vector2D topleft = change.apply(Vector2D(-margin, -margin));
+            Vector2D bottomright = change.apply(Vector2D(cache.textureWidth - margin, cache.textureHeight - margin));
+            camera->drawTexture(cache.texture, topleft, bottomright - topleft);
         }
 };
 
-// Class extending drawable used to a background grid
-class GridDrawable : public Drawable {
+// Class extending drawable used to draw the potential felt by a body as a shaded
+// background with its zero-velocity contour. Every viewport samples its own field
+class PotentialDrawable : public Drawable {
     private:
-        int width;
-        int height;
-        int spacing;
+        struct View {
+            PotentialField field;
+            SDL_Texture *texture = nullptr;
+            int textureColumns = 0;
+            int textureRows = 0;
+            std::vector<ContourSegment> contour;
+            View(float strength) : field(strength) {}
+        };
+        PhysicsWorld *world;
+        CorotatingFrame *frame;
+        float strength;
+        std::unordered_map<Viewport*, View> views;
+        std::vector<uint32_t> pixels;
+        std::vector<Vector2D> sources;
+        // Recompute the field of a viewport if the bodies or its view moved by more than a pixel
+        bool refresh(Camera *camera, Viewport *viewport, View &view) {
+            PotentialField &field = view.field;
+            bool rotating = viewport->corotating && frame->enabled;
+            // The field is the potential per unit mass of the watched body, so
+            // its own attraction is left out and the strength is divided by its mass.
+            PhysicsBody &target = world->bodies[body];
+            field.strength = strength / target.getMass();
+            sources.clear();
+            Vector2D position = target.getPosition();
+            Vector2D velocity = target.getVelocity();
+            float omega = 0;
+            Vector2D center;
+            for (int i = 0; i < world->bodies.size(); i++) {
+                if (i == body) continue;
+                sources.push_back(rotating
+                        ? frame->origin + Vector2D(frame->states.x[i], frame->states.y[i])
+                        : world->bodies[i].getPosition());
+            }
+            if (rotating) {
+                // The origin of the frame is the barycenter of the pair, which does not
+                // accelerate, so the centrifugal term is the only one the frame adds
+                omega = frame->omega;
+                center = frame->origin;
+                position = frame->origin + Vector2D(frame->states.x[body], frame->states.y[body]);
+                velocity = Vector2D(frame->states.vx[body], frame->states.vy[body]);
+            }
+
+            float spacing = field.spacing;
+            Affine2D toWorld = viewport->view.inverse();
+            Vector2D origin = toWorld.apply(Vector2D(0, 0));
+            Vector2D stepX = toWorld.apply(Vector2D(spacing, 0)) - origin;
+            Vector2D stepY = toWorld.apply(Vector2D(0, spacing)) - origin;
+            if (!field.update(sources, omega, center, origin, stepX, stepY, viewport->width, viewport->height)) return false;
+            // The body can only reach the region where the potential is
+            // below its energy, so the contour at that level bounds its motion.
+            float energy = field.evaluate(position) + 0.5f * (velocity.x * velocity.x + velocity.y * velocity.y);
+            field.shade(pixels, energy);
+            if (view.texture == nullptr || view.textureColumns != field.columns || view.textureRows != field.rows) {
+                if (view.texture != nullptr) SDL_DestroyTexture(view.texture);
+                view.texture = camera->createTexture(field.columns, field.rows);
+                view.textureColumns = field.columns;
+                view.textureRows = field.rows;
+            }
+            SDL_UpdateTexture(view.texture, NULL, pixels.data(), field.columns * sizeof(uint32_t));
+            view.contour.clear();
+            field.contour(energy, view.contour);
+            return true;
+        }
     public:
-        GridDrawable(int width, int height, int spacing) {
-            this->width = width;
-            this->height = height;
-            this->spacing = spacing;
-            this->depth = 10;
+        int body = 0;
+        bool enabled = false;
+        PotentialDrawable(PhysicsWorld *world, CorotatingFrame *frame, float strength) {
+            this->world = world;
+            this->frame = frame;
+            this->strength = strength;
+            this->depth = 15;
         }
-        void draw(Camera *camera) {
-            camera->setDrawColor(Color::darkGray());
-            for (int x = 0; x < width; x += spacing) {
-                camera->drawLine(Vector2D(x, 0), Vector2D(x, height));
+        ~PotentialDrawable() {
+            for (auto &entry : views) {
+                if (entry.second.texture != nullptr) SDL_DestroyTexture(entry.second.texture);
             }
-            for (int y = 0; y < height; y += spacing) {
-                camera->drawLine(Vector2D(0, y), Vector2D(width, y));
+        }
+        // Recompute the fields of the viewports drawn so far with their last views,
+        // and return whether any of them changed, so that it has to be drawn again
+        bool update(Camera *camera) {
+            if (!enabled || body >= world->bodies.size()) return false;
+            bool recomputed = false;
+            for (auto &entry : views) {
+                if (!entry.first->shown) continue;
+                recomputed = refresh(camera, entry.first, entry.second) || recomputed;
+            }
+            return recomputed;
+        }
+        void draw(Camera *camera) {
+            if (!enabled || body >= world->bodies.size()) return;
+            Viewport *viewport = camera->getViewport();
+            View &view = views.try_emplace(viewport, strength).first->second;
+            refresh(camera, viewport, view);
+            float spacing = view.field.spacing;
+            // Every texel is centered on its sample.
+            camera->drawTexture(view.texture, Vector2D(-spacing / 2, -spacing / 2),
+                    Vector2D(view.field.columns * spacing, view.field.rows * spacing));
+            camera->setDrawColor(Color::orange());
+            for (int i = 0; i < view.contour.size(); i++) {
+                camera->drawLine(view.contour[i].start, view.contour[i].end);
             }
         }
 };
 
+// Class extending drawable used to draw a predicted trajectory and the events along it
+// in the frame each viewport shows
 class TrajectoryDrawable : public Drawable {
     private:
-        PhysicsBody *body;
+        // The fitted path in the frame of one reference, tessellated once for all
+        // viewports that show that frame, so each of them only transforms and culls it
+        struct Tessellation {
+            std::vector<float> x, y;
+            ChunkBounds chunks;
+            // The scale it was tessellated for, or zero if it is out of date
+            float scale = 0;
+        };
+        RelativeTrajectoryEngine *engine;
+        PhysicsWorld *world;
+        CorotatingFrame *frame;
+        int body;
+        std::vector<float> markers;
+        bool closed = false;
+        AdaptiveTessellator tessellator;
         std::vector<Vector2D> points;
+        // The tessellations of every frame, one per power of 4 of the scale
+        std::unordered_map<uint64_t, std::map<int, Tessellation>> tessellations;
+        // Get the tessellation of the path in a frame, fine enough for a scale. Scales are
+        // rounded up to a power of 4, so views of one frame at different zooms keep their own
+        // tessellations, and zooming within a power of 4 reuses one
+        Tessellation &tessellate(float scale, int reference, FrameRotation rotation, int secondary) {
+            int level = (int)std::ceil(std::log(scale) / std::log(4.0f));
+            Tessellation &path = tessellations[RelativeTrajectoryEngine::key(body, reference, rotation, secondary)][level];
+            if (path.scale > 0) return path;
+            scale = std::pow(4.0f, level);
+            float start, end;
+            engine->span(start, end);
+            RelativeTrajectoryEngine *e = engine;
+            int b = body;
+            points.clear();
+            tessellator.tessellate(scale, [e, b, reference, rotation, secondary](float t) {
+                return e->evaluate(b, reference, t, rotation, secondary);
+            }, start, end, e->pieces(b, reference), points);
+            path.x.resize(points.size());
+            path.y.resize(points.size());
+            for (int i = 0; i < points.size(); i++) {
+                path.x[i] = points[i].x;
+                path.y[i] = points[i].y;
+            }
+            path.chunks.compute(path.x.data(), path.y.data(), path.x.size());
+            path.scale = scale;
+            return path;
+        }
     public:
-        TrajectoryDrawable(PhysicsBody *body) {
+        TrajectoryDrawable(RelativeTrajectoryEngine *engine, PhysicsWorld *world, CorotatingFrame *frame, int body) {
+            this->engine = engine;
+            this->world = world;
+            this->frame = frame;
             this->body = body;
             this->depth = 4;
+            this->threadSafe = true;
         }
         void draw(Camera *camera) {
+            // A trajectory relative to its own body is a point, so it is shown in the world frame instead
+            ViewReference view = ViewReference::of(camera->getViewport(), world, frame);
+            if (view.fixes(body)) view = ViewReference();
+            int reference = view.reference, secondary = view.secondary;
+            FrameRotation rotation = view.rotation;
+            Vector2D anchor = view.anchor;
             camera->setDrawColor(Color::gray());
-            if (points.size() < 2) {
-                return;
+            if (engine->continuous()) {
+                // Tessellate the fitted path instead of drawing the integration samples
+                Tessellation &path = tessellate(camera->getView().scale(), reference, rotation, secondary);
+                camera->drawPolyline(path.x.data(), path.y.data(), path.x.size(), path.chunks, anchor, closed);
+            } else {
+                RelativePath &path = engine->path(body, reference, rotation, secondary);
+                camera->drawPolyline(path.x.data(), path.y.data(), path.size(), path.chunks, anchor, closed);
             }
-            for (int i = 0; i < points.size() - 1; ++i) {
-                camera->drawLine(points[i], points[i + 1]);
+            camera->setDrawColor(Color::yellow());
+            for (int i = 0; i < markers.size(); ++i) {
+                camera->drawCross(anchor + engine->evaluate(body, reference, markers[i], rotation, secondary), 4);
             }
         }
-        void addPoint(Vector2D point) {
-            points.push_back(point);
+        // The bounds of the path in the frame of the viewport, padded for the markers. They are
+        // taken from the samples, which the engine caches, so culling costs no tessellation.
+        // The fitted curve can bulge a little past its samples, which the padding covers
+        Bounds bounds(Camera *camera) {
+            ViewReference view = ViewReference::of(camera->getViewport(), world, frame);
+            if (view.fixes(body)) view = ViewReference();
+            RelativePath &path = engine->path(body, view.reference, view.rotation, view.secondary);
+            const Bounds &total = path.chunks.total;
+            float extent = total.empty() ? 0 : std::max(total.max.x - total.min.x, total.max.y - total.min.y);
+            return total.translated(view.anchor).padded(4 + 0.01f * extent);
         }
+        void setBody(int body) {
+            this->body = body;
+            invalidate();
+        }
+        void addMarker(float time) {
+            markers.push_back(time);
+            markDirty();
+        }
+        void setClosed(bool closed) {
+            this->closed = closed;
+            markDirty();
+        }
+        // Forget the markers, and the tessellations since the path changed with them
         void clear() {
-            points.clear();
+            markers.clear();
+            closed = false;
+            invalidate();
+        }
+        // Mark the tessellations out of date, keeping their memory
+        void invalidate() {
+            for (auto &entry : tessellations) {
+                for (auto &level : entry.second) level.second.scale = 0;
+            }
+            markDirty();
         }
 };
 
-void applyGravitationalForces(float strength, PhysicsWorld &world) {
-    for (int i = 0; i < world.bodies.size(); i++) {
-        for (int j = i + 1; j < world.bodies.size(); j++) {
-            PhysicsBody &body1 = world.bodies[i];
-            PhysicsBody &body2 = world.bodies[j];
-            Vector2D distance = body2.getPosition() - body1.getPosition();
-            float distanceMagnitude = distance.magnitude();
-            float forceMagnitude = strength / (distanceMagnitude * distanceMagnitude);
-            Vector2D force = distance.normalized() * forceMagnitude;
-            body1.applyForce(force);
-            body2.applyForce(-force);
-        }
+int main(int argc, char *argv[]) {
+    // --threads N sets the number of worker threads, and --pin binds the
+    // workers to cores of their own, keeping them off core 0. With 0, everything
+    // runs on the main thread and long predictions are computed a slice per frame
+    int threads = -1;
+    bool pin = false;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) threads = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--pin") == 0) pin = true;
     }
-}
+    ThreadPool::configure(threads, pin);
 
-int main(int argc, char *argv[]) {
     // Initialize SDL
     Camera camera("Simulation", NULL, 1000, 1000);
 
-    // Initialize the world
+    // Initialize the world and run it on its own thread. The renderer draws
+    // the latest snapshot of the simulation, moved into the variables below.
+    Simulation simulation(GRAVITATIONAL_CONSTANT);
+    initWorld(simulation.world);
+    simulation.trackedBody = 1;
+    simulation.predictor.steps = 1000;
+    simulation.predictor.escapeDistance = 2000;
+    simulation.sliced = threads == 0;
+    // The simulation owns its state once it runs, so this is read before
+    int trackedBody = simulation.trackedBody;
+    simulation.start();
     PhysicsWorld world;
-    initWorld(world);
-    Frame2D globalFrame = Frame2D(NULL, Vector2D(0, 0), 0, Vector2D(1, 1));
-    Frame2D cameraFrame = Frame2D(&globalFrame, Vector2D(0, 0), 0, Vector2D(1, 1));
-    camera.setFrame(&cameraFrame);
-    BodyDrawable bodyDrawable1(&world.bodies[0]);
-    BodyDrawable bodyDrawable2(&world.bodies[1]);
-    GridDrawable gridDrawable(1000, 1000, 100);
-    TrajectoryDrawable trajectoryDrawable1(&world.bodies[1]);
+    Propagation propagation;
+    EphemerisSet ephemeris;
+    std::vector<int> bodyIndex;
+    FrameNode globalFrame(NULL, Vector2D(0, 0), 0, Vector2D(1, 1));
+    // Four views of the same simulation: the world frame, the frame of the first
+    // body, the co-rotating frame and a zoomed out world frame. Only the first is
+    // shown until V splits the window.
+    int width = camera.getWindowWidth(), height = camera.getWindowHeight();
+    std::vector<std::unique_ptr<FrameNode>> viewFrames;
+    for (int v = 0; v < 4; v++) {
+        float scale = v == 3 ? 0.5 : 1;
+        viewFrames.push_back(std::make_unique<FrameNode>(&globalFrame, Vector2D(0, 0), 0, Vector2D(scale, scale)));
+        Viewport *viewport = v == 0 ? camera.getViewport(0) : camera.addViewport(0, 0, width / 2, height / 2);
+        viewport->node = viewFrames[v].get();
+        viewport->shown = v == 0;
+    }
+    camera.getViewport(1)->reference = 0;
+    camera.getViewport(2)->corotating = true;
+    bool split = false;
+    int focused = 0;
+    CorotatingFrame corotating;
+    RelativeTrajectoryEngine relativeEngine;
+    // Markers, arrows and paths of all bodies; the tracked body has its own trajectory
+    BodyVisuals bodyVisuals(&world, &corotating, &relativeEngine);
+    GridDrawable gridDrawable(100);
+    PotentialDrawable potentialDrawable(&world, &corotating, GRAVITATIONAL_CONSTANT);
+    TrajectoryDrawable trajectoryDrawable1(&relativeEngine, &world, &corotating, trackedBody);
+    camera.addDrawable(&bodyVisuals);
+    camera.addDrawable(&gridDrawable);
+    camera.addDrawable(&potentialDrawable);
+    camera.addDrawable(&trajectoryDrawable1);
+    // The grid and the potential change rarely, so they are kept in a texture
+    camera.addLayer(10, 20);
     
     // Main loop
     bool running = true;
-    Uint32 lastTime = SDL_GetTicks();
-    Uint32 currentTime;
-    float deltaTime;
+    Uint32 lastFrame = SDL_GetTicks();
     while (running) {
-        // Calculate delta time
-        currentTime = SDL_GetTicks();
-        float deltaTime = (currentTime - lastTime) / 1000.0f;
-        lastTime = currentTime;
-
         // Handle SDL events
         SDL_Event event;
+        bool changed = false;
         while (SDL_PollEvent(&event)) {
             if (event.type == SDL_QUIT) {
                 running = false;
             }
+            if (event.type == SDL_KEYDOWN) {
+                changed = true;
+            }
+            // The window lost what was presented, so every view is drawn again
+            if (event.type == SDL_WINDOWEVENT && (event.window.event == SDL_WINDOWEVENT_EXPOSED ||
+                    event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED || event.window.event == SDL_WINDOWEVENT_RESTORED)) {
+                changed = true;
+                for (int v = 0; v < camera.getViewportCount(); v++) {
+                    camera.getViewport(v)->invalidate();
+                }
+            }
+            // Space pauses and resumes the simulation
+            if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_SPACE) {
+                simulation.paused = !simulation.paused;
+            }
+            // V switches between one view and four views
+            if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_v) {
+                split = !split;
+                focused = 0;
+                for (int v = 0; v < camera.getViewportCount(); v++) {
+                    Viewport *viewport = camera.getViewport(v);
+                    if (split) viewport->setRect(v % 2 * width / 2, v / 2 * height / 2, width / 2, height / 2);
+                    else viewport->setRect(0, 0, width, height);
+                    viewport->shown = split || v == 0;
+                }
+            }
+            // Tab moves the focus to the next view, which the keys below apply to
+            if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_TAB && split) {
+                focused = (focused + 1) % camera.getViewportCount();
+            }
+            // 0 shows the world frame, 1-9 the frame of the body with that number
+            if (event.type == SDL_KEYDOWN && event.key.keysym.sym >= SDLK_0 && event.key.keysym.sym <= SDLK_9) {
+                camera.getViewport(focused)->reference = event.key.keysym.sym - SDLK_1;
+                camera.getViewport(focused)->invalidate();
+            }
+            // C toggles the frame co-rotating with the first two bodies
+            if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_c) {
+                camera.getViewport(focused)->corotating = !camera.getViewport(focused)->corotating;
+                camera.getViewport(focused)->invalidate();
+            }
+            // P toggles the potential of the tracked body in the background
+            if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_p) {
+                potentialDrawable.enabled = !potentialDrawable.enabled;
+                potentialDrawable.markDirty();
+            }
         }
 
-        // Update the world
-        world.update(deltaTime);
-        applyGravitationalForces(GRAVITATIONAL_CONSTANT, world);
-
-        trajectoryDrawable1.clear();
-        PhysicsWorld world_copy = world.clone();
-        for (int i=0; i<100; i++) {
-            world_copy.update(20/world_copy.bodies[1].getVelocity().magnitude());
-            applyGravitationalForces(GRAVITATIONAL_CONSTANT, world_copy);
-            trajectoryDrawable1.addPoint(world_copy.bodies[1].getPosition());
+        // The co-rotating frame is only updated while a view shows it
+        corotating.enabled = false;
+        for (int v = 0; v < camera.getViewportCount(); v++) {
+            Viewport *viewport = camera.getViewport(v);
+            corotating.enabled = corotating.enabled || (viewport->shown && viewport->corotating);
         }
+        // Take the latest snapshot of the simulation, if there is a new one
+        if (simulation.sliced) simulation.update();
+        bool updated = simulation.snapshots.update();
+        if (updated) {
+            SimulationSnapshot &snapshot = simulation.snapshots.read();
+            if (snapshot.bodyIndex != bodyIndex) {
+                // Bodies merged, so the views and drawables have to be
+                // pointed at the bodies that are left.
+                if (!bodyIndex.empty()) {
+                    for (int v = 0; v < camera.getViewportCount(); v++) {
+                        Viewport *viewport = camera.getViewport(v);
+                        viewport->reference = remapBody(viewport->reference, bodyIndex, snapshot.bodyIndex);
+                    }
+                    corotating.primary = remapBody(corotating.primary, bodyIndex, snapshot.bodyIndex);
+                    corotating.secondary = remapBody(corotating.secondary, bodyIndex, snapshot.bodyIndex);
+                }
+                bodyIndex = snapshot.bodyIndex;
+                bodyVisuals.clear();
+                for (int i = 0; i < snapshot.world.bodies.size(); i++) {
+                    bodyVisuals.addBody(i, i != snapshot.trackedBody);
+                }
+            }
+            // The snapshot belongs to this thread until the next update, so its state is moved out
+            world = std::move(snapshot.world);
+            propagation = std::move(snapshot.propagation);
+            ephemeris = std::move(snapshot.ephemeris);
+            relativeEngine.setPropagation(&propagation, &ephemeris);
+            trackedBody = snapshot.trackedBody;
 
-        // Draw the world
-        cameraFrame.setPosition(
-            Vector2D::lerp(
-                cameraFrame.getPosition(),
-                world.bodies[1].getPosition(),
-                0.01));
-        camera.render();
-
+            trajectoryDrawable1.clear();
+            trajectoryDrawable1.setBody(trackedBody);
+            for (int i = 0; i < snapshot.events.size(); i++) {
+                trajectoryDrawable1.addMarker(snapshot.events[i]);
+            }
+            trajectoryDrawable1.setClosed(snapshot.closed);
+            potentialDrawable.body = trackedBody;
+        }
+        // While paused, the state only changes on key presses and window events
+        if (updated || changed) {
+            if (corotating.enabled) {
+                corotating.update(world);
+            }
+            for (int v = 0; v < camera.getViewportCount(); v++) {
+                Viewport *viewport = camera.getViewport(v);
+                if (viewport->reference >= (int)world.bodies.size()) viewport->reference = -1;
+            }
+            bodyVisuals.markDirty();
+            if (potentialDrawable.update(&camera)) potentialDrawable.markDirty();
+        }
 
-        SDL_Delay(5);
+        // Draw the world. The views follow their bodies by elapsed time, since
+        // frames that change nothing are skipped and the frame rate varies
+        Uint32 now = SDL_GetTicks();
+        float elapsed = (now - lastFrame) / 1000.0f;
+        lastFrame = now;
+        for (int v = 0; v < camera.getViewportCount(); v++) {
+            Viewport *viewport = camera.getViewport(v);
+            // The co-rotating view is centered on the origin of its frame, which is no body
+            if (viewport->corotating && corotating.enabled) {
+                viewFrames[v]->follow(nullptr, 0);
+                viewFrames[v]->setPosition(Vector2D::lerp(viewFrames[v]->getPosition(), corotating.origin, FrameNode::blend(0.01, elapsed)));
+                continue;
+            }
+            // Merges can leave the followed body, or every body, gone
+            int followed = viewport->reference >= 0 ? viewport->reference : trackedBody;
+            if (followed >= 0 && followed < (int)world.bodies.size()) viewFrames[v]->follow(&world.bodies[followed], 0.01);
+            else viewFrames[v]->follow(nullptr, 0);
+        }
+        globalFrame.tick(elapsed);
+        // When nothing changed, sleep until the next event or snapshot instead of polling
+        if (camera.render()) SDL_Delay(5);
+        else SDL_WaitEventTimeout(NULL, simulation.paused ? 50 : 5);
     }
-    SDL_Quit();
+    simulation.stop();
+    // SDL is shut down by the camera, which is destroyed after the drawables
+    // and frames declared after it have freed their textures
     return 0;
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #ifndef PHYSICS_H
 #define PHYSICS_H
 #include "Vector2D.h"
+#include "threadpool.h"
 #include <vector>
 
 /// @brief A physics body with position, velocity, acceleration, and mass.
@@ -80,6 +81,14 @@ class PhysicsBody {
             return mass;
         }
 
+        /// @brief Get the radius of the physics body.
+        /// @return The radius of the physics body.
+        /// @details Bodies are drawn and collided as circles whose radius is equal to their mass.
+        /// @see getMass
+        float getRadius() {
+            return mass;
+        }
+
         /// @brief Set the velocity of the physics body.
         /// @param velocity The velocity of the physics body.
         /// @details This function sets the velocity of the physics body. The velocity is used to calculate the new position of the physics body when the physics body is updated.
@@ -164,12 +173,11 @@ class PhysicsWorld {
         /// @brief Update the physics world with a time step.
         /// @param dt The time step to update the physics world with.
         /// @details Updates all the physics bodies in the physics world with the given time step.
+        /// Large worlds are updated in parallel on the shared thread pool.
         /// @see PhysicsBody::update(float dt)
         void update(float dt) {
             ++ticks;
-            for (int i = 0; i < bodies.size(); i++) {
-                bodies[i].update(dt);
-            }
+            ThreadPool::global().parallelFor(0, bodies.size(), [this, dt](int i) { bodies[i].update(dt); }, 1024);
         }
 
         /// @brief Get a copy of the physics world.
@@ -185,4 +193,42 @@ class PhysicsWorld {
         }
 };
 
+/// @brief Apply the gravitational forces between all pairs of bodies.
+/// @param strength The magnitude of the force between two bodies at unit distance.
+/// @param world The physics world whose bodies attract each other.
+/// @details The force between two bodies is strength / distance^2, directed along the line between them.
+/// Small worlds visit every pair once. In large worlds every body sums the
+/// forces on itself instead, which computes every pair twice but lets the
+/// bodies be done in parallel on the shared thread pool without sharing writes.
+void applyGravitationalForces(float strength, PhysicsWorld &world) {
+    int n = world.bodies.size();
+    if (n >= 64) {
+        ThreadPool::global().parallelFor(0, n, [strength, &world, n](int i) {
+            PhysicsBody &body1 = world.bodies[i];
+            Vector2D total = Vector2D::zero();
+            for (int j = 0; j < n; j++) {
+                if (j == i) continue;
+                Vector2D distance = world.bodies[j].getPosition() - body1.getPosition();
+                float distanceMagnitude = distance.magnitude();
+                float forceMagnitude = strength / (distanceMagnitude * distanceMagnitude);
+                total += distance.normalized() * forceMagnitude;
+            }
+            body1.applyForce(total);
+        }, 8);
+        return;
+    }
+    for (int i = 0; i < world.bodies.size(); i++) {
+        for (int j = i + 1; j < world.bodies.size(); j++) {
+            PhysicsBody &body1 = world.bodies[i];
+            PhysicsBody &body2 = world.bodies[j];
+            Vector2D distance = body2.getPosition() - body1.getPosition();
+            float distanceMagnitude = distance.magnitude();
+            float forceMagnitude = strength / (distanceMagnitude * distanceMagnitude);
+            Vector2D force = distance.normalized() * forceMagnitude;
+            body1.applyForce(force);
+            body2.applyForce(-force);
+        }
+    }
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,243 @@
+#ifndef POTENTIAL_H
+#define POTENTIAL_H
+#include "threadpool.h"
+#include "Vector2D.h"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+/// @brief A line segment of a contour, in world coordinates.
+struct ContourSegment {
+    Vector2D start;
+    Vector2D end;
+};
+
+/// @brief The gravitational potential sampled on a grid over the view.
+/// @details The grid is laid out in screen space, one sample every few pixels,
+/// and every sample is mapped to the world through an affine transformation.
+/// The potential of a unit test mass is evaluated in tiles that are spread
+/// over the shared ThreadPool; inside a tile the loop over a row of samples
+/// is free of branches, so the compiler vectorises it. In a rotating frame the
+/// centrifugal term is added, which gives the effective potential. Its center
+/// has to be a point that does not accelerate, like the barycenter of the pair
+/// the frame rotates with: around an accelerating point the potential would
+/// miss the term of that acceleration, and the energy of a body moving in the
+/// frame would not be conserved. Contours at a given level are extracted with
+/// marching squares.
+///
+/// Evaluating the field is expensive, so the result is cached. It is only
+/// recomputed when a body, the center of rotation or the view moves by more
+/// than a pixel, or when the angular velocity changes enough to move the
+/// centrifugal term by that much at the edge of the view.
+class PotentialField {
+    private:
+        std::vector<float> sourceX, sourceY;
+        float cachedOmega = NAN;
+        Vector2D cachedOrigin, cachedStepX, cachedStepY;
+
+        /// Check whether the inputs differ from the cached ones by more than a pixel.
+        bool changed(std::vector<Vector2D> &sources, float omega, Vector2D center, Vector2D origin, Vector2D stepX, Vector2D stepY) {
+            if (sources.size() != sourceX.size() || std::isnan(cachedOmega)) return true;
+            // One world unit in pixels, from the length of a sample step.
+            float pixel = 1 / std::max(stepX.magnitude() / spacing, 1e-12f);
+            if ((center - this->center).magnitude() * pixel > 1) return true;
+            if ((origin - cachedOrigin).magnitude() * pixel > 1) return true;
+            if ((stepX - cachedStepX).magnitude() * columns * pixel > 1) return true;
+            if ((stepY - cachedStepY).magnitude() * rows * pixel > 1) return true;
+            for (int i = 0; i < sources.size(); i++) {
+                float dx = sources[i].x - sourceX[i];
+                float dy = sources[i].y - sourceY[i];
+                if (std::sqrt(dx * dx + dy * dy) * pixel > 1) return true;
+            }
+            if (omega != cachedOmega) {
+                // A relative change of omega moves a contour of the centrifugal
+                // term at distance r by about r times that change, so it is
+                // measured at the corner of the view farthest from the center.
+                float reach = 0;
+                for (int corner = 0; corner < 4; corner++) {
+                    Vector2D p = origin + stepX * (float)((corner & 1) * columns) + stepY * (float)((corner >> 1) * rows);
+                    reach = std::max(reach, (p - center).magnitude());
+                }
+                float scale = std::max(std::fabs(omega), std::fabs(cachedOmega));
+                if (std::fabs(omega - cachedOmega) * reach * pixel > scale) return true;
+            }
+            return false;
+        }
+
+        void evaluateTile(int tile) {
+            int tilesX = (columns + tileSize - 1) / tileSize;
+            int x0 = (tile % tilesX) * tileSize;
+            int y0 = (tile / tilesX) * tileSize;
+            int x1 = std::min(x0 + tileSize, columns);
+            int y1 = std::min(y0 + tileSize, rows);
+            int n = sourceX.size();
+            float w2 = 0.5f * cachedOmega * cachedOmega;
+            for (int y = y0; y < y1; y++) {
+                float *__restrict row = &values[y * columns];
+                float baseX = cachedOrigin.x + y * cachedStepY.x;
+                float baseY = cachedOrigin.y + y * cachedStepY.y;
+                for (int x = x0; x < x1; x++) {
+                    float px = baseX + x * cachedStepX.x - center.x;
+                    float py = baseY + x * cachedStepX.y - center.y;
+                    row[x] = -w2 * (px * px + py * py);
+                }
+                for (int i = 0; i < n; i++) {
+                    float sx = sourceX[i], sy = sourceY[i];
+                    for (int x = x0; x < x1; x++) {
+                        float dx = baseX + x * cachedStepX.x - sx;
+                        float dy = baseY + x * cachedStepX.y - sy;
+                        row[x] -= strength / std::sqrt(dx * dx + dy * dy + softening);
+                    }
+                }
+            }
+        }
+
+        /// Interpolate the position of a contour crossing on a grid edge.
+        Vector2D crossing(int x0, int y0, int x1, int y1, float level) {
+            float a = values[y0 * columns + x0];
+            float b = values[y1 * columns + x1];
+            float t = (level - a) / (b - a);
+            float x = x0 + (x1 - x0) * t;
+            float y = y0 + (y1 - y0) * t;
+            return cachedOrigin + cachedStepX * x + cachedStepY * y;
+        }
+
+    public:
+        /// @brief The magnitude of the gravitational force at unit distance.
+        float strength;
+        /// @brief A small length squared added to distances to avoid infinities at the bodies.
+        float softening = 1;
+        /// @brief The distance between samples, in pixels.
+        int spacing = 4;
+        /// @brief The side length of a tile, in samples.
+        int tileSize = 32;
+        /// @brief The number of columns of samples.
+        int columns = 0;
+        /// @brief The number of rows of samples.
+        int rows = 0;
+        /// @brief The potential at every sample, row by row.
+        std::vector<float> values;
+        /// @brief The center of rotation, for the centrifugal term. It must not accelerate.
+        Vector2D center;
+        /// @brief Whether the last call to update recomputed the field.
+        bool recomputed = false;
+
+        /// @brief Create a potential field.
+        /// @param strength The magnitude of the gravitational force at unit distance.
+        PotentialField(float strength) {
+            this->strength = strength;
+        }
+
+        /// @brief Update the field if the bodies or the view moved by more than a pixel.
+        /// @param sources The positions of the bodies, in world coordinates.
+        /// @param omega The angular velocity of the frame, or zero for an inertial frame.
+        /// @param center The center of rotation, in world coordinates, which must not accelerate.
+        /// @param origin The world position of the top left sample.
+        /// @param stepX The world offset between two samples in a row.
+        /// @param stepY The world offset between two rows.
+        /// @param width The width of the view, in pixels.
+        /// @param height The height of the view, in pixels.
+        /// @return True if the field was recomputed.
+        bool update(std::vector<Vector2D> &sources, float omega, Vector2D center,
+                    Vector2D origin, Vector2D stepX, Vector2D stepY, int width, int height) {
+            int newColumns = width / spacing + 1;
+            int newRows = height / spacing + 1;
+            recomputed = newColumns != columns || newRows != rows ||
+                    changed(sources, omega, center, origin, stepX, stepY);
+            if (!recomputed) return false;
+
+            columns = newColumns;
+            rows = newRows;
+            values.resize(columns * rows);
+            sourceX.resize(sources.size());
+            sourceY.resize(sources.size());
+            for (int i = 0; i < sources.size(); i++) {
+                sourceX[i] = sources[i].x;
+                sourceY[i] = sources[i].y;
+            }
+            cachedOmega = omega;
+            cachedOrigin = origin;
+            cachedStepX = stepX;
+            cachedStepY = stepY;
+            this->center = center;
+            int tiles = ((columns + tileSize - 1) / tileSize) * ((rows + tileSize - 1) / tileSize);
+            ThreadPool::global().parallelFor(0, tiles, [this](int tile) { evaluateTile(tile); });
+            return true;
+        }
+
+        /// @brief Evaluate the potential at a single point.
+        /// @param position The point, in world coordinates.
+        float evaluate(Vector2D position) {
+            Vector2D d = position - center;
+            float value = -0.5f * cachedOmega * cachedOmega * (d.x * d.x + d.y * d.y);
+            for (int i = 0; i < sourceX.size(); i++) {
+                float dx = position.x - sourceX[i];
+                float dy = position.y - sourceY[i];
+                value -= strength / std::sqrt(dx * dx + dy * dy + softening);
+            }
+            return value;
+        }
+
+        /// @brief Extract the contour lines at a level with marching squares.
+        /// @param level The potential of the contour.
+        /// @param segments The segments of the contour are appended to this.
+        void contour(float level, std::vector<ContourSegment> &segments) {
+            for (int y = 0; y + 1 < rows; y++) {
+                for (int x = 0; x + 1 < columns; x++) {
+                    float v0 = values[y * columns + x];
+                    float v1 = values[y * columns + x + 1];
+                    float v2 = values[(y + 1) * columns + x + 1];
+                    float v3 = values[(y + 1) * columns + x];
+                    int cell = (v0 > level) | (v1 > level) << 1 | (v2 > level) << 2 | (v3 > level) << 3;
+                    if (cell == 0 || cell == 15) continue;
+                    // Crossings on the top, right, bottom and left edges.
+                    Vector2D edges[4];
+                    bool crossed[4] = {
+                        (v0 > level) != (v1 > level),
+                        (v1 > level) != (v2 > level),
+                        (v3 > level) != (v2 > level),
+                        (v0 > level) != (v3 > level)
+                    };
+                    if (crossed[0]) edges[0] = crossing(x, y, x + 1, y, level);
+                    if (crossed[1]) edges[1] = crossing(x + 1, y, x + 1, y + 1, level);
+                    if (crossed[2]) edges[2] = crossing(x, y + 1, x + 1, y + 1, level);
+                    if (crossed[3]) edges[3] = crossing(x, y, x, y + 1, level);
+                    if (cell == 5 || cell == 10) {
+                        // Saddle: decide by the value at the center of the cell.
+                        bool high = 0.25f * (v0 + v1 + v2 + v3) > level;
+                        if ((cell == 5) == high) {
+                            segments.push_back({edges[0], edges[1]});
+                            segments.push_back({edges[2], edges[3]});
+                        } else {
+                            segments.push_back({edges[0], edges[3]});
+                            segments.push_back({edges[1], edges[2]});
+                        }
+                        continue;
+                    }
+                    int first = -1;
+                    for (int e = 0; e < 4; e++) {
+                        if (!crossed[e]) continue;
+                        if (first < 0) first = e;
+                        else segments.push_back({edges[first], edges[e]});
+                    }
+                }
+            }
+        }
+
+        /// @brief Shade the field into 32-bit RGBA pixels, one per sample.
+        /// @param pixels Set to columns * rows pixels.
+        /// @param reference The potential that maps to the brightest shade.
+        void shade(std::vector<uint32_t> &pixels, float reference) {
+            pixels.resize(values.size());
+            float scale = 1 / std::max(std::fabs(reference), 1e-12f);
+            for (int i = 0; i < values.size(); i++) {
+                // Deeper potential wells are brighter.
+                float depth = std::min(std::max(-values[i] * scale, 0.0f), 4.0f) * 0.25f;
+                uint32_t level = (uint32_t)(depth * 160);
+                pixels[i] = (level / 4) << 24 | (level / 3) << 16 | level << 8 | 255;
+            }
+        }
+};
+
+#endif
@@ -0,0 +1,634 @@
+#ifndef PREDICTION_H
+#define PREDICTION_H
+#include "physics.h"
+#include "Vector2D.h"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <climits>
+
+/// @brief The sampled path of a single body, stored as separate coordinate arrays.
+struct BodyTrack {
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> vx;
+    std::vector<float> vy;
+};
+
+/// @brief The states of all bodies at every step of a prediction.
+/// @details Samples are taken at non-uniform times. Between two samples the
+/// state is interpolated with a cubic Hermite curve through the positions and
+/// velocities at both ends, which gives a continuous (dense) output of the
+/// propagation without re-integrating.
+class Propagation {
+    public:
+        /// @brief The time of every sample, relative to the start of the prediction.
+        std::vector<float> times;
+        /// @brief The samples of every body.
+        std::vector<BodyTrack> tracks;
+        /// @brief The mass of every body, taken at the first sample.
+        /// @details Bodies do not merge during a prediction, so the masses stay the same.
+        std::vector<float> masses;
+
+        /// @brief Remove all samples.
+        /// @param bodies The number of bodies that will be sampled.
+        void clear(int bodies) {
+            times.clear();
+            tracks.resize(bodies);
+            for (int i = 0; i < bodies; i++) {
+                tracks[i].x.clear();
+                tracks[i].y.clear();
+                tracks[i].vx.clear();
+                tracks[i].vy.clear();
+            }
+        }
+
+        /// @brief Record the state of all bodies in a physics world.
+        /// @param time The time of the sample.
+        /// @param world The physics world to sample.
+        void addSample(float time, PhysicsWorld &world) {
+            if (times.empty()) {
+                masses.resize(tracks.size());
+                for (int i = 0; i < tracks.size(); i++) masses[i] = world.bodies[i].mass;
+            }
+            times.push_back(time);
+            for (int i = 0; i < tracks.size(); i++) {
+                PhysicsBody &body = world.bodies[i];
+                tracks[i].x.push_back(body.position.x);
+                tracks[i].y.push_back(body.position.y);
+                tracks[i].vx.push_back(body.velocity.x);
+                tracks[i].vy.push_back(body.velocity.y);
+            }
+        }
+
+        /// @brief Get the number of samples.
+        int size() {
+            return times.size();
+        }
+
+        /// @brief Get the number of sampled bodies.
+        int bodies() {
+            return tracks.size();
+        }
+
+        /// @brief Get the position of a body at a sample.
+        Vector2D position(int body, int sample) {
+            return Vector2D(tracks[body].x[sample], tracks[body].y[sample]);
+        }
+
+        /// @brief Get the velocity of a body at a sample.
+        Vector2D velocity(int body, int sample) {
+            return Vector2D(tracks[body].vx[sample], tracks[body].vy[sample]);
+        }
+
+        /// @brief Find the sample interval containing a time.
+        /// @return The index of the last sample at or before the given time, clamped so that the interval [index, index + 1] exists.
+        int findInterval(float time) {
+            int low = 0;
+            int high = (int)times.size() - 1;
+            if (high < 1) return 0;
+            while (high - low > 1) {
+                int middle = (low + high) / 2;
+                if (times[middle] <= time) low = middle;
+                else high = middle;
+            }
+            return low;
+        }
+
+        /// @brief Interpolate the state of a body inside a sample interval.
+        /// @param body The index of the body.
+        /// @param sample The index of the first sample of the interval.
+        /// @param time The time to interpolate at.
+        /// @param position Set to the interpolated position.
+        /// @param velocity Set to the interpolated velocity.
+        void interpolate(int body, int sample, float time, Vector2D &position, Vector2D &velocity) {
+            BodyTrack &track = tracks[body];
+            if (sample + 1 >= times.size()) {
+                position = Vector2D(track.x[sample], track.y[sample]);
+                velocity = Vector2D(track.vx[sample], track.vy[sample]);
+                return;
+            }
+            float h = times[sample + 1] - times[sample];
+            float s = h > 0 ? (time - times[sample]) / h : 0;
+            float s2 = s * s;
+            float s3 = s2 * s;
+            float h00 = 2 * s3 - 3 * s2 + 1, h10 = s3 - 2 * s2 + s;
+            float h01 = -2 * s3 + 3 * s2, h11 = s3 - s2;
+            float d00 = 6 * s2 - 6 * s, d10 = 3 * s2 - 4 * s + 1;
+            float d01 = -6 * s2 + 6 * s, d11 = 3 * s2 - 2 * s;
+            int a = sample, b = sample + 1;
+            position = Vector2D(
+                    h00 * track.x[a] + h10 * h * track.vx[a] + h01 * track.x[b] + h11 * h * track.vx[b],
+                    h00 * track.y[a] + h10 * h * track.vy[a] + h01 * track.y[b] + h11 * h * track.vy[b]);
+            if (h <= 0) {
+                velocity = Vector2D(track.vx[a], track.vy[a]);
+                return;
+            }
+            velocity = Vector2D(
+                    (d00 * track.x[a] + d01 * track.x[b]) / h + d10 * track.vx[a] + d11 * track.vx[b],
+                    (d00 * track.y[a] + d01 * track.y[b]) / h + d10 * track.vy[a] + d11 * track.vy[b]);
+        }
+
+        /// @brief Interpolate the state of a body at any time of the prediction.
+        /// @see interpolate(int, int, float, Vector2D&, Vector2D&)
+        void interpolate(int body, float time, Vector2D &position, Vector2D &velocity) {
+            interpolate(body, findInterval(time), time, position, velocity);
+        }
+};
+
+/// @brief The kind of a trajectory event.
+enum class EventType {
+    /// @brief The closest point of a bound orbit around the other body.
+    Periapsis,
+    /// @brief The farthest point of a bound orbit around the other body.
+    Apoapsis,
+    /// @brief The closest point of an unbound pass by the other body.
+    ClosestApproach,
+    /// @brief The bodies touch.
+    Impact
+};
+
+/// @brief An event found along a predicted trajectory.
+struct TrajectoryEvent {
+    EventType type;
+    /// @brief The body the event happens to.
+    int body;
+    /// @brief The body the event is measured against.
+    int other;
+    /// @brief The time of the event, relative to the start of the prediction.
+    float time;
+    /// @brief The time of the event within the stored propagation.
+    /// @details This differs from time when a closed orbit is reused, since the propagation then starts earlier on the orbit.
+    float sampleTime;
+    /// @brief The position of the body at the time of the event.
+    Vector2D position;
+    /// @brief The velocity of the body at the time of the event.
+    Vector2D velocity;
+    /// @brief The distance between the bodies at the time of the event.
+    float distance;
+};
+
+/// @brief The reason a prediction stopped.
+enum class PredictionEnd {
+    /// @brief The maximum number of steps was reached.
+    Steps,
+    /// @brief The tracked body left the escape distance and is moving away.
+    Escape,
+    /// @brief The tracked body hit another body.
+    Impact,
+    /// @brief The tracked body returned to its initial state, closing its orbit.
+    Closed
+};
+
+/// @brief A pair of bodies whose relative motion is watched for events.
+struct EventWatch {
+    int body;
+    int other;
+};
+
+/// @brief Predicts the future trajectories of the bodies in a physics world.
+/// @details The prediction integrates a copy of the world with steps sized so
+/// that the tracked body moves a fixed distance per step. Every step is checked
+/// for events between watched pairs of bodies: a sign change of the radial
+/// velocity marks a periapsis, apoapsis or closest approach, and the distance
+/// dropping below the sum of the radii marks an impact. The exact time of each
+/// event is then found by bisection on the interpolated states, so events are
+/// precise without sampling the trajectory densely.
+///
+/// The prediction stops early when the tracked body escapes, hits another body,
+/// or returns to its initial state relative to the reference body. A closed
+/// orbit is kept and reused by the following predictions for as long as the
+/// tracked body and the other bodies are still found within a small fraction
+/// of its size from it, between its samples; the samples are
+/// moved along with the reference body, which may drift in the meantime. A
+/// bound orbit costs one period of steps once instead of the full step budget
+/// every frame.
+///
+/// A prediction can also be computed in slices: start() sets it up and every
+/// call to resume() continues it for a limited number of steps or time,
+/// keeping the integration state in the predictor in between. The samples and
+/// events found so far are in propagation and events after every slice, so a
+/// long prediction can be shown while it grows.
+class Predictor {
+    private:
+        Vector2D relativePosition(int sample) {
+            return propagation.position(trackedBody, sample) - propagation.position(activeReference, sample);
+        }
+
+        Vector2D relativeVelocity(int sample) {
+            return propagation.velocity(trackedBody, sample) - propagation.velocity(activeReference, sample);
+        }
+
+        /// Resolve the reference body: the one set in reference, or the
+        /// heaviest body other than the tracked one if it is -1 or out of range.
+        void chooseReference(PhysicsWorld &world) {
+            activeReference = reference;
+            if (activeReference >= 0 && activeReference < world.bodies.size() && activeReference != trackedBody) return;
+            activeReference = -1;
+            for (int i = 0; i < world.bodies.size(); i++) {
+                if (i == trackedBody) continue;
+                if (activeReference < 0 || world.bodies[i].getMass() > world.bodies[activeReference].getMass()) activeReference = i;
+            }
+        }
+
+        /// Try to find the current state of the tracked body on the last closed orbit.
+        bool reuseClosedOrbit(PhysicsWorld &world) {
+            // Merges renumber the bodies, but they also leave fewer of them, so
+            // closedBody and closedReference are never compared across a merge.
+            if (end != PredictionEnd::Closed || propagation.bodies() != world.bodies.size()) return false;
+            if (closedBody != trackedBody || closedReference != activeReference) return false;
+            Vector2D position = world.bodies[trackedBody].position - world.bodies[activeReference].position;
+            Vector2D velocity = world.bodies[trackedBody].velocity - world.bodies[activeReference].velocity;
+            int best = -1;
+            float bestDistance = INFINITY;
+            float size = 0;
+            for (int i = 0; i < propagation.size(); i++) {
+                Vector2D sampled = relativePosition(i);
+                float distance = (sampled - position).magnitude();
+                size = std::max(size, sampled.magnitude());
+                if (distance < bestDistance) {
+                    best = i;
+                    bestDistance = distance;
+                }
+            }
+            if (best < 0 || bestDistance > closureTolerance) return false;
+
+            // The samples are far apart compared to the tolerance, so the
+            // closest point of the orbit is found between them, where the
+            // distance to the body stops shrinking.
+            int sample = best;
+            auto approach = [&](float t) {
+                Vector2D p, v, rp, rv;
+                propagation.interpolate(trackedBody, sample, t, p, v);
+                propagation.interpolate(activeReference, sample, t, rp, rv);
+                Vector2D d = p - rp - position;
+                Vector2D w = v - rv;
+                return d.x * w.x + d.y * w.y;
+            };
+            float when = propagation.times[best];
+            if (best > 0 && approach(when) > 0) {
+                sample = best - 1;
+                if (approach(propagation.times[sample]) < 0) when = bisect(sample, approach);
+            } else if (best + 1 < propagation.size()) {
+                sample = best;
+                if (approach(propagation.times[sample + 1]) > 0) when = bisect(sample, approach);
+            }
+            Vector2D tracked, trackedVelocity, origin, originVelocity;
+            propagation.interpolate(trackedBody, sample, when, tracked, trackedVelocity);
+            propagation.interpolate(activeReference, sample, when, origin, originVelocity);
+            // The predicted orbit and the simulated body drift apart, because
+            // they are integrated with different steps. The orbit is only
+            // reused while the body is within a pixel-scale fraction of it.
+            float tolerance = reuseTolerance * size;
+            if ((tracked - origin - position).magnitude() > tolerance) return false;
+            Vector2D expected = trackedVelocity - originVelocity;
+            if ((expected - velocity).magnitude() > velocityTolerance * expected.magnitude()) return false;
+            // The orbit only repeats if the other bodies are where they were at that point of it.
+            for (int i = 0; i < world.bodies.size(); i++) {
+                if (i == trackedBody || i == activeReference) continue;
+                Vector2D p, v;
+                propagation.interpolate(i, sample, when, p, v);
+                Vector2D sampled = p - origin;
+                Vector2D current = world.bodies[i].position - world.bodies[activeReference].position;
+                if ((sampled - current).magnitude() > tolerance) return false;
+                Vector2D sampledVelocity = v - originVelocity;
+                Vector2D currentVelocity = world.bodies[i].velocity - world.bodies[activeReference].velocity;
+                if ((sampledVelocity - currentVelocity).magnitude() > velocityTolerance * sampledVelocity.magnitude()) return false;
+            }
+
+            // The reference has drifted since the orbit was sampled, so the
+            // samples and events are moved along with it.
+            shift = world.bodies[activeReference].position - origin;
+            for (int i = 0; i < propagation.bodies(); i++) {
+                BodyTrack &track = propagation.tracks[i];
+                for (int j = 0; j < track.x.size(); j++) {
+                    track.x[j] += shift.x;
+                    track.y[j] += shift.y;
+                }
+            }
+            for (int i = 0; i < events.size(); i++) {
+                events[i].position = events[i].position + shift;
+            }
+
+            // Shift the events so that their times are measured from the
+            // current point on the orbit.
+            float phase = when - phaseOffset;
+            phaseOffset = when;
+            for (int i = 0; i < events.size(); i++) {
+                events[i].time = std::fmod(events[i].time - phase + 2 * period, period);
+            }
+            std::stable_sort(events.begin(), events.end(),
+                    [](const TrajectoryEvent &a, const TrajectoryEvent &b) { return a.time < b.time; });
+            return true;
+        }
+
+        /// Check whether the prediction should stop after the given sample.
+        bool finished(int sample, float &closest, bool &departed) {
+            for (int i = eventsChecked; i < events.size(); i++) {
+                if (events[i].type == EventType::Impact && events[i].body == trackedBody) {
+                    end = PredictionEnd::Impact;
+                    return true;
+                }
+            }
+            eventsChecked = events.size();
+            if (activeReference < 0) return false;
+
+            Vector2D position = relativePosition(sample);
+            Vector2D velocity = relativeVelocity(sample);
+            float distance = position.magnitude();
+            if (distance > escapeDistance && position.x * velocity.x + position.y * velocity.y > 0) {
+                end = PredictionEnd::Escape;
+                return true;
+            }
+
+            // The orbit closes at the first local minimum of the distance to
+            // the initial state that is within tolerance, once the body has
+            // been farther away than the tolerance.
+            float fromStart = (position - relativePosition(0)).magnitude();
+            if (fromStart > 2 * closureTolerance) departed = true;
+            if (departed && fromStart > closest && closest < closureTolerance) {
+                Vector2D start = relativeVelocity(0);
+                if ((relativeVelocity(sample - 1) - start).magnitude() <= velocityTolerance * start.magnitude()) {
+                    end = PredictionEnd::Closed;
+                    return true;
+                }
+            }
+            closest = fromStart;
+            return false;
+        }
+
+        float relativeRate(int body, int other, int sample, float time, Vector2D &position, Vector2D &velocity, float &distance) {
+            Vector2D otherPosition, otherVelocity;
+            propagation.interpolate(body, sample, time, position, velocity);
+            propagation.interpolate(other, sample, time, otherPosition, otherVelocity);
+            Vector2D r = position - otherPosition;
+            Vector2D v = velocity - otherVelocity;
+            distance = r.magnitude();
+            return r.x * v.x + r.y * v.y;
+        }
+
+        float gap(int body, int other, int sample, float time, float radius) {
+            Vector2D position, velocity, otherPosition, otherVelocity;
+            propagation.interpolate(body, sample, time, position, velocity);
+            propagation.interpolate(other, sample, time, otherPosition, otherVelocity);
+            return (position - otherPosition).magnitude() - radius;
+        }
+
+        /// Find the root of gap or relativeRate inside a sample interval by bisection.
+        template <typename F>
+        float bisect(int sample, F f) {
+            float low = propagation.times[sample];
+            float high = propagation.times[sample + 1];
+            float fLow = f(low);
+            for (int i = 0; i < bisectionIterations; i++) {
+                float middle = 0.5f * (low + high);
+                float fMiddle = f(middle);
+                if ((fMiddle < 0) == (fLow < 0)) {
+                    low = middle;
+                    fLow = fMiddle;
+                } else {
+                    high = middle;
+                }
+            }
+            return 0.5f * (low + high);
+        }
+
+        void detectEvents(int sample, std::vector<float> &rates, std::vector<float> &gaps, std::vector<float> &radii, std::vector<float> &masses) {
+            for (int w = 0; w < watches.size(); w++) {
+                int body = watches[w].body;
+                int other = watches[w].other;
+                Vector2D position, velocity;
+                float distance;
+                float rate = relativeRate(body, other, sample + 1, propagation.times[sample + 1], position, velocity, distance);
+                float radius = radii[body] + radii[other];
+                float g = distance - radius;
+                float previousRate = rates[w];
+                float previousGap = gaps[w];
+                rates[w] = rate;
+                gaps[w] = g;
+
+                if (previousGap > 0 && g <= 0) {
+                    float time = bisect(sample, [&](float t) { return gap(body, other, sample, t, radius); });
+                    TrajectoryEvent event{};
+                    event.type = EventType::Impact;
+                    event.body = body;
+                    event.other = other;
+                    event.time = time;
+                    event.sampleTime = time;
+                    relativeRate(body, other, sample, time, event.position, event.velocity, event.distance);
+                    events.push_back(event);
+                }
+                if ((previousRate < 0) == (rate < 0)) continue;
+
+                float time = bisect(sample, [&](float t) {
+                    Vector2D p, v;
+                    float d;
+                    return relativeRate(body, other, sample, t, p, v, d);
+                });
+                TrajectoryEvent event{};
+                event.type = EventType::Periapsis;
+                event.body = body;
+                event.other = other;
+                event.time = time;
+                event.sampleTime = time;
+                relativeRate(body, other, sample, time, event.position, event.velocity, event.distance);
+                Vector2D otherPosition, otherVelocity;
+                propagation.interpolate(other, sample, time, otherPosition, otherVelocity);
+                Vector2D v = event.velocity - otherVelocity;
+                // With a force of strength / r^2 between the bodies, the
+                // relative motion is a Kepler orbit with this parameter.
+                float mu = strength * (1 / masses[body] + 1 / masses[other]);
+                bool bound = 0.5f * (v.x * v.x + v.y * v.y) - mu / event.distance < 0;
+                if (previousRate >= 0) {
+                    if (!bound) continue;
+                    event.type = EventType::Apoapsis;
+                } else if (!bound) {
+                    event.type = EventType::ClosestApproach;
+                }
+                events.push_back(event);
+            }
+        }
+
+        int eventsChecked = 0;
+        int closedBody = -1;
+        int closedReference = -1;
+        /// The reference body of the current prediction, resolved from reference.
+        int activeReference = -1;
+        float phaseOffset = 0;
+
+        // The state of the prediction between slices.
+        PhysicsWorld copy;
+        std::vector<float> radii, masses, rates, gaps;
+        float time = 0;
+        float closest = INFINITY;
+        bool departed = false;
+        int step = 0;
+        bool running = false;
+
+        /// Close the orbit, if the prediction ended on one, and sort the events.
+        void finish() {
+            running = false;
+            if (end == PredictionEnd::Closed) {
+                // The last sample is already past the closest return, so the
+                // orbit ends at the one before it and the polyline is closed
+                // back to the first sample.
+                int last = propagation.size() - 2;
+                float next = propagation.times[last + 1];
+                propagation.times.pop_back();
+                for (int i = 0; i < propagation.bodies(); i++) {
+                    propagation.tracks[i].x.pop_back();
+                    propagation.tracks[i].y.pop_back();
+                    propagation.tracks[i].vx.pop_back();
+                    propagation.tracks[i].vy.pop_back();
+                }
+                while (!events.empty() && events.back().time > propagation.times[last]) events.pop_back();
+                period = 0.5f * (propagation.times[last] + next);
+                closedBody = trackedBody;
+                closedReference = activeReference;
+            }
+            std::stable_sort(events.begin(), events.end(),
+                    [](const TrajectoryEvent &a, const TrajectoryEvent &b) { return a.time < b.time; });
+        }
+
+    public:
+        /// @brief The magnitude of the gravitational force at unit distance.
+        float strength;
+        /// @brief The body whose speed determines the step size.
+        int trackedBody = 0;
+        /// @brief The number of integration steps of a prediction.
+        int steps = 100;
+        /// @brief The distance the tracked body moves in a single step.
+        float stepLength = 20;
+        /// @brief The number of bisection steps used to refine an event time.
+        int bisectionIterations = 24;
+        /// @brief The pairs of bodies that are checked for events.
+        std::vector<EventWatch> watches;
+        /// @brief The body the tracked body orbits, or -1 to use the heaviest other body.
+        int reference = -1;
+        /// @brief The distance from the reference body beyond which an outbound body has escaped.
+        float escapeDistance = INFINITY;
+        /// @brief How close the tracked body has to return to its initial position for the orbit to be closed.
+        float closureTolerance = 20;
+        /// @brief How close the tracked body has to be to a closed orbit for it to be reused, as a fraction of the orbit's size.
+        /// @details The size is the largest distance of the orbit from the reference body.
+        float reuseTolerance = 0.005f;
+        /// @brief How close the relative velocity has to return to its initial value, as a fraction of it.
+        float velocityTolerance = 0.1f;
+        /// @brief The states of all bodies during the last prediction.
+        Propagation propagation;
+        /// @brief The events found during the last prediction, in order of time.
+        std::vector<TrajectoryEvent> events;
+        /// @brief Why the last prediction stopped.
+        PredictionEnd end = PredictionEnd::Steps;
+        /// @brief The period of the last closed orbit.
+        float period = 0;
+        /// @brief Whether the last prediction reused a closed orbit instead of integrating.
+        bool reused = false;
+        /// @brief How far the samples of a reused orbit were moved to follow the reference body.
+        Vector2D shift;
+
+        /// @brief Create a predictor.
+        /// @param strength The magnitude of the gravitational force at unit distance.
+        /// @see applyGravitationalForces
+        Predictor(float strength) {
+            this->strength = strength;
+        }
+
+        /// @brief Watch a body for events against every other body in a world.
+        /// @param body The index of the body to watch.
+        /// @param bodies The number of bodies in the world.
+        void watchAll(int body, int bodies) {
+            watches.clear();
+            for (int i = 0; i < bodies; i++) {
+                if (i != body) watches.push_back({body, i});
+            }
+        }
+
+        /// @brief Predict the future of a physics world.
+        /// @param world The physics world to predict. It is not modified.
+        /// @details The states of all bodies are stored in propagation and the
+        /// events found along the way in events. If the tracked body is still
+        /// on the orbit closed by an earlier prediction, that orbit is kept and
+        /// only the event times are shifted.
+        void predict(PhysicsWorld &world) {
+            if (!start(world)) resume(INT_MAX);
+        }
+
+        /// @brief Start a prediction that is computed in slices by resume().
+        /// @param world The physics world to predict. It is copied, so it may change while the prediction runs.
+        /// @return Whether the prediction is already complete, because a closed orbit was reused or there is nothing to predict.
+        bool start(PhysicsWorld &world) {
+            running = false;
+            chooseReference(world);
+            reused = reuseClosedOrbit(world);
+            if (reused) return true;
+
+            copy = world.clone();
+            int bodies = copy.bodies.size();
+            propagation.clear(bodies);
+            events.clear();
+            end = PredictionEnd::Steps;
+            period = 0;
+            phaseOffset = 0;
+            eventsChecked = 0;
+            if (trackedBody >= bodies) return true;
+
+            radii.resize(bodies);
+            masses.resize(bodies);
+            for (int i = 0; i < bodies; i++) {
+                radii[i] = copy.bodies[i].getRadius();
+                masses[i] = copy.bodies[i].getMass();
+            }
+            time = 0;
+            propagation.addSample(time, copy);
+            rates.resize(watches.size());
+            gaps.resize(watches.size());
+            for (int w = 0; w < watches.size(); w++) {
+                Vector2D position, velocity;
+                float distance;
+                rates[w] = relativeRate(watches[w].body, watches[w].other, 0, 0, position, velocity, distance);
+                gaps[w] = distance - radii[watches[w].body] - radii[watches[w].other];
+            }
+            closest = INFINITY;
+            departed = false;
+            step = 0;
+            running = true;
+            return false;
+        }
+
+        /// @brief Continue the prediction started by start().
+        /// @param maxSteps The most integration steps to take.
+        /// @param seconds The most time to spend, in seconds.
+        /// @return Whether the prediction is complete.
+        /// @details The clock is only read every few steps, so a slice can
+        /// overrun its time by a few steps.
+        bool resume(int maxSteps, float seconds = INFINITY) {
+            if (!running) return true;
+            auto begin = std::chrono::steady_clock::now();
+            for (int taken = 0; taken < maxSteps && step < steps; taken++) {
+                float dt = stepLength / copy.bodies[trackedBody].getVelocity().magnitude();
+                copy.update(dt);
+                applyGravitationalForces(strength, copy);
+                time += dt;
+                propagation.addSample(time, copy);
+                detectEvents(step, rates, gaps, radii, masses);
+                step++;
+                if (finished(step, closest, departed)) break;
+                if (taken % 16 == 15 && seconds < INFINITY &&
+                    std::chrono::duration<float>(std::chrono::steady_clock::now() - begin).count() > seconds) {
+                    return false;
+                }
+            }
+            if (end == PredictionEnd::Steps && step < steps) return false;
+            finish();
+            return true;
+        }
+
+        /// @brief Check whether a prediction started by start() is not complete yet.
+        bool inProgress() {
+            return running;
+        }
+};
+
+#endif
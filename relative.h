@@ -0,0 +1,282 @@
+#ifndef RELATIVE_H
+#define RELATIVE_H
+#include "prediction.h"
+#include "ephemeris.h"
+#include "bounds.h"
+#include "Vector2D.h"
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+/// @brief How the axes of a body-attached frame are oriented.
+enum class FrameRotation {
+    /// @brief The axes are parallel to the world axes.
+    None,
+    /// @brief The x axis points along the velocity of the reference body.
+    Velocity,
+    /// @brief The x axis points from the reference body to a secondary body.
+    Line,
+    /// @brief Like Line, but the origin is the barycenter of the reference and the secondary body.
+    /// @details This is the frame of CorotatingFrame, so paths in it line up
+    /// with the bodies and the potential drawn there.
+    Barycentric
+};
+
+/// @brief The path of a body in the frame of another body.
+struct RelativePath {
+    std::vector<float> x;
+    std::vector<float> y;
+    /// @brief The bounds of chunks of the path, for culling.
+    ChunkBounds chunks;
+
+    /// @brief Get the number of points of the path.
+    int size() {
+        return x.size();
+    }
+
+    /// @brief Get a point of the path.
+    Vector2D point(int i) {
+        return Vector2D(x[i], y[i]);
+    }
+};
+
+/// @brief Produces the paths of bodies in the frames of other bodies from one shared propagation.
+/// @details The engine never propagates. It takes the samples of a single
+/// Propagation and, for any pair of bodies (A, B), computes the path of A in a
+/// frame attached to B, translated to B and optionally rotated with it. The
+/// transform runs over whole coordinate arrays at once in loops without
+/// branches or calls, which the compiler turns into SIMD code. Results are
+/// cached per pair until the propagation changes, so switching the reference
+/// body is a table lookup, or one pass over the samples the first time.
+class RelativeTrajectoryEngine {
+    private:
+        Propagation *propagation = nullptr;
+        EphemerisSet *ephemerides = nullptr;
+        std::unordered_map<uint64_t, RelativePath> paths;
+        std::vector<float> cosines;
+        std::vector<float> sines;
+        std::vector<float> originX;
+        std::vector<float> originY;
+        /// Guards the cache, so paths can be requested from several threads.
+        std::mutex mutex;
+
+        /// Compute the barycenter of the reference and the secondary body at every sample.
+        void barycenters(int reference, int secondary) {
+            int n = propagation->size();
+            originX.resize(n);
+            originY.resize(n);
+            BodyTrack &b = propagation->tracks[reference];
+            BodyTrack &c = propagation->tracks[secondary];
+            float total = propagation->masses[reference] + propagation->masses[secondary];
+            float wb = propagation->masses[reference] / total;
+            float wc = propagation->masses[secondary] / total;
+            for (int i = 0; i < n; i++) {
+                originX[i] = wb * b.x[i] + wc * c.x[i];
+                originY[i] = wb * b.y[i] + wc * c.y[i];
+            }
+        }
+
+        /// Compute the orientation of the frame at every sample.
+        void orientations(int reference, FrameRotation rotation, int secondary) {
+            int n = propagation->size();
+            cosines.resize(n);
+            sines.resize(n);
+            BodyTrack &b = propagation->tracks[reference];
+            if (rotation == FrameRotation::Velocity) {
+                direction(b.vx.data(), b.vy.data(), nullptr, nullptr, cosines.data(), sines.data(), n);
+            } else {
+                BodyTrack &c = propagation->tracks[secondary];
+                direction(c.x.data(), c.y.data(), b.x.data(), b.y.data(), cosines.data(), sines.data(), n);
+            }
+        }
+
+    public:
+        /// @brief Get the key of the path of a body in the frame of another body.
+        /// @details Paths are cached by this key, and so can be anything derived from them.
+        static uint64_t key(int body, int reference, FrameRotation rotation, int secondary) {
+            return ((uint64_t)(uint16_t)body << 48) | ((uint64_t)(uint16_t)reference << 32) |
+                   ((uint64_t)(uint16_t)secondary << 16) | (uint64_t)rotation;
+        }
+
+        /// @brief Compute unit directions for a batch of vectors.
+        /// @param x The x coordinates of the vector ends.
+        /// @param y The y coordinates of the vector ends.
+        /// @param ox The x coordinates of the vector starts, or nullptr for vectors from the origin.
+        /// @param oy The y coordinates of the vector starts, or nullptr for vectors from the origin.
+        /// @param c Set to the cosines of the directions.
+        /// @param s Set to the sines of the directions.
+        /// @param n The number of vectors.
+        static void direction(const float *__restrict x, const float *__restrict y,
+                              const float *__restrict ox, const float *__restrict oy,
+                              float *__restrict c, float *__restrict s, int n) {
+            if (ox == nullptr) {
+                for (int i = 0; i < n; i++) {
+                    float inverse = 1 / std::sqrt(x[i] * x[i] + y[i] * y[i] + 1e-20f);
+                    c[i] = x[i] * inverse;
+                    s[i] = y[i] * inverse;
+                }
+                return;
+            }
+            for (int i = 0; i < n; i++) {
+                float dx = x[i] - ox[i];
+                float dy = y[i] - oy[i];
+                float inverse = 1 / std::sqrt(dx * dx + dy * dy + 1e-20f);
+                c[i] = dx * inverse;
+                s[i] = dy * inverse;
+            }
+        }
+
+        /// @brief Translate a batch of points into frames with the given origins.
+        static void translate(const float *__restrict ax, const float *__restrict ay,
+                              const float *__restrict bx, const float *__restrict by,
+                              float *__restrict x, float *__restrict y, int n) {
+            for (int i = 0; i < n; i++) {
+                x[i] = ax[i] - bx[i];
+                y[i] = ay[i] - by[i];
+            }
+        }
+
+        /// @brief Translate and rotate a batch of points into frames with the given origins and orientations.
+        static void transform(const float *__restrict ax, const float *__restrict ay,
+                              const float *__restrict bx, const float *__restrict by,
+                              const float *__restrict c, const float *__restrict s,
+                              float *__restrict x, float *__restrict y, int n) {
+            for (int i = 0; i < n; i++) {
+                float dx = ax[i] - bx[i];
+                float dy = ay[i] - by[i];
+                x[i] = c[i] * dx + s[i] * dy;
+                y[i] = c[i] * dy - s[i] * dx;
+            }
+        }
+
+        /// @brief Use a new propagation.
+        /// @param propagation The samples all paths are computed from.
+        /// @param ephemerides The ephemerides fitted to the propagation, or nullptr.
+        /// @details All cached paths are dropped.
+        void setPropagation(Propagation *propagation, EphemerisSet *ephemerides) {
+            this->propagation = propagation;
+            this->ephemerides = ephemerides;
+            paths.clear();
+        }
+
+        /// @brief Get the path of a body in the frame of another body.
+        /// @param body The body whose path is wanted.
+        /// @param reference The body the frame is attached to, or -1 for the world frame.
+        /// @param rotation How the frame is oriented.
+        /// @param secondary The body the x axis points to, for FrameRotation::Line and FrameRotation::Barycentric.
+        /// @return The path, with one point per sample of the propagation.
+        /// @details This is safe to call from several threads at once, but not
+        /// while the propagation is replaced.
+        RelativePath &path(int body, int reference, FrameRotation rotation = FrameRotation::None, int secondary = 0) {
+            std::lock_guard<std::mutex> lock(mutex);
+            uint64_t k = key(body, reference, rotation, secondary);
+            auto found = paths.find(k);
+            if (found != paths.end()) return found->second;
+
+            RelativePath &result = paths[k];
+            int n = propagation->size();
+            BodyTrack &a = propagation->tracks[body];
+            if (reference < 0) {
+                result.x = a.x;
+                result.y = a.y;
+            } else {
+                result.x.resize(n);
+                result.y.resize(n);
+                BodyTrack &b = propagation->tracks[reference];
+                if (rotation == FrameRotation::None) {
+                    translate(a.x.data(), a.y.data(), b.x.data(), b.y.data(), result.x.data(), result.y.data(), n);
+                } else if (rotation == FrameRotation::Barycentric) {
+                    orientations(reference, rotation, secondary);
+                    barycenters(reference, secondary);
+                    transform(a.x.data(), a.y.data(), originX.data(), originY.data(),
+                              cosines.data(), sines.data(), result.x.data(), result.y.data(), n);
+                } else {
+                    orientations(reference, rotation, secondary);
+                    transform(a.x.data(), a.y.data(), b.x.data(), b.y.data(),
+                              cosines.data(), sines.data(), result.x.data(), result.y.data(), n);
+                }
+            }
+            result.chunks.compute(result.x.data(), result.y.data(), n);
+            return result;
+        }
+
+        /// @brief Compute the paths of many pairs of bodies at once.
+        /// @param pairs The (body, reference) pairs.
+        /// @param rotation How the frames are oriented.
+        /// @param secondary The body the x axis points to, for FrameRotation::Line and FrameRotation::Barycentric.
+        void computeAll(std::vector<std::pair<int, int>> &pairs, FrameRotation rotation = FrameRotation::None, int secondary = 0) {
+            for (int i = 0; i < pairs.size(); i++) {
+                path(pairs[i].first, pairs[i].second, rotation, secondary);
+            }
+        }
+
+        /// @brief Check whether there is a propagation to compute paths from.
+        bool ready() {
+            return propagation != nullptr && propagation->size() > 1;
+        }
+
+        /// @brief Get the number of bodies in the propagation.
+        int bodies() {
+            return propagation != nullptr ? propagation->bodies() : 0;
+        }
+
+        /// @brief Check whether continuous evaluation is available.
+        bool continuous() {
+            return ephemerides != nullptr && !ephemerides->bodies.empty() && !ephemerides->bodies[0].empty();
+        }
+
+        /// @brief Get the number of pieces a path should be split into before tessellating it.
+        /// @details This is the larger of the segment counts of the two ephemerides, so every piece is covered by a single polynomial of each body.
+        int pieces(int body, int reference) {
+            if (!continuous()) return std::max(1, propagation->size() - 1);
+            int segments = ephemerides->bodies[body].segments;
+            if (reference >= 0) segments = std::max(segments, ephemerides->bodies[reference].segments);
+            return segments;
+        }
+
+        /// @brief Get the time span of the propagation.
+        void span(float &start, float &end) {
+            start = propagation->times.empty() ? 0 : propagation->times.front();
+            end = propagation->times.empty() ? 0 : propagation->times.back();
+        }
+
+        /// @brief Evaluate the position of a body in the frame of another body at any time.
+        /// @details This uses the ephemerides if continuous() is true and the
+        /// dense output of the propagation otherwise.
+        /// @see path
+        Vector2D evaluate(int body, int reference, float time, FrameRotation rotation = FrameRotation::None, int secondary = 0) {
+            Vector2D position = worldPosition(body, time);
+            if (reference < 0) return position;
+            Vector2D origin = worldPosition(reference, time);
+            Vector2D d = position - origin;
+            if (rotation == FrameRotation::None) return d;
+            Vector2D axis;
+            if (rotation == FrameRotation::Velocity) {
+                Vector2D unused;
+                if (continuous()) axis = ephemerides->bodies[reference].velocity(time);
+                else propagation->interpolate(reference, time, unused, axis);
+            } else {
+                Vector2D other = worldPosition(secondary, time);
+                axis = other - origin;
+                if (rotation == FrameRotation::Barycentric) {
+                    float mb = propagation->masses[reference], mc = propagation->masses[secondary];
+                    d = position - (origin * mb + other * mc) / (mb + mc);
+                }
+            }
+            axis /= axis.magnitude();
+            return Vector2D(axis.x * d.x + axis.y * d.y, axis.x * d.y - axis.y * d.x);
+        }
+
+        /// @brief Evaluate the position of a body in the world frame at any time.
+        Vector2D worldPosition(int body, float time) {
+            if (continuous()) return ephemerides->bodies[body].position(time);
+            Vector2D position, velocity;
+            propagation->interpolate(body, time, position, velocity);
+            return position;
+        }
+};
+
+#endif
@@ -0,0 +1,453 @@
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+#include "SDL2/SDL.h"
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+/// @brief The kind of primitive a draw command holds.
+enum class PrimitiveType : uint8_t {
+    /// @brief Separate line segments, two vertices each.
+    Lines,
+    /// @brief A chain of connected line segments.
+    Polyline,
+    /// @brief Single pixels.
+    Points,
+    /// @brief A texture copied to a rectangle.
+    Texture,
+    /// @brief Rectangles cut from one texture and tinted by the color.
+    Sprite
+};
+
+/// @brief A run of primitives of one type and color.
+struct DrawCommand {
+    PrimitiveType type;
+    /// @brief The color as 0xRRGGBBAA.
+    uint32_t color;
+    int depth;
+    /// @brief The index of the first vertex, of the texture for PrimitiveType::Texture, or of the first sprite for PrimitiveType::Sprite.
+    int first;
+    /// @brief The number of vertices or sprites.
+    int count;
+    /// @brief The texture the sprites are cut from.
+    SDL_Texture *texture;
+};
+
+/// @brief A rectangle of a texture drawn to a rectangle on the screen.
+struct SpriteQuad {
+    /// @brief The rectangle on the screen, in pixels.
+    SDL_FRect destination;
+    /// @brief The rectangle in the texture, as texture coordinates.
+    SDL_FRect source;
+};
+
+/// @brief Clip a batch of line segments to a rectangle with the Liang-Barsky algorithm.
+/// @param x0 The x coordinates of the starts of the segments.
+/// @param y0 The y coordinates of the starts of the segments.
+/// @param x1 The x coordinates of the ends of the segments.
+/// @param y1 The y coordinates of the ends of the segments.
+/// @param colors The colors of the segments, moved along with them.
+/// @param n The number of segments.
+/// @param rect The rectangle.
+/// @return The number of segments that intersect the rectangle.
+/// @details Segments that miss the rectangle are dropped, and the remaining
+/// ones are clipped in place and moved to the front of the arrays.
+inline int clipSegments(float *x0, float *y0, float *x1, float *y1, uint32_t *colors, int n, SDL_FRect rect) {
+    float left = rect.x, right = rect.x + rect.w;
+    float top = rect.y, bottom = rect.y + rect.h;
+    int kept = 0;
+    for (int i = 0; i < n; i++) {
+        float ax = x0[i], ay = y0[i], bx = x1[i], by = y1[i];
+        // Segments entirely on the outer side of one edge are the common case.
+        if ((ax < left && bx < left) || (ax > right && bx > right) ||
+            (ay < top && by < top) || (ay > bottom && by > bottom)) continue;
+        float dx = bx - ax, dy = by - ay;
+        float p[4] = {-dx, dx, -dy, dy};
+        float q[4] = {ax - left, right - ax, ay - top, bottom - ay};
+        float t0 = 0, t1 = 1;
+        bool inside = true;
+        for (int e = 0; e < 4; e++) {
+            if (p[e] == 0) {
+                if (q[e] < 0) inside = false;
+                continue;
+            }
+            float t = q[e] / p[e];
+            if (p[e] < 0) t0 = std::max(t0, t);
+            else t1 = std::min(t1, t);
+        }
+        if (!inside || t0 > t1) continue;
+        x0[kept] = ax + t0 * dx;
+        y0[kept] = ay + t0 * dy;
+        x1[kept] = ax + t1 * dx;
+        y1[kept] = ay + t1 * dy;
+        colors[kept] = colors[i];
+        kept++;
+    }
+    return kept;
+}
+
+/// @brief A texture to copy to the screen.
+struct TextureCopy {
+    SDL_Texture *texture;
+    SDL_FRect rect;
+};
+
+/// @brief Records screen-space primitives and submits them to SDL in large batches.
+/// @details Drawing a primitive only appends its vertices to a buffer. Primitives
+/// recorded one after another with the same type, color and depth extend the
+/// same command instead of starting a new one.
+///
+/// When the queue is flushed, the commands are sorted by depth, farthest
+/// first, and within a depth by primitive type and color. Only the order
+/// between depths is kept, so primitives of one depth may be drawn in a
+/// different order than they were recorded. Every depth is then submitted in
+/// a few calls: its textures, one SDL_RenderGeometry call for all of its lines
+/// and polylines with a thin quad per segment and a color per vertex, one
+/// SDL_RenderGeometry call per texture of its sprites, and one
+/// SDL_RenderDrawPointsF call per color of its points. Lines are clipped to
+/// the viewport in one pass before their quads are built, so segments far
+/// off the screen never reach the renderer.
+class RenderQueue {
+    private:
+        std::vector<SDL_Vertex> geometry;
+        std::vector<int> indices;
+        std::vector<SDL_FPoint> points;
+        /// The indices of the commands in the order they are submitted.
+        std::vector<int> order;
+        /// The segments of a line batch, before and after clipping.
+        std::vector<float> x0, y0, x1, y1;
+        std::vector<uint32_t> colors;
+
+        /// Start a new command, or return the last one if the primitive can be appended to it.
+        DrawCommand &command(PrimitiveType type, uint32_t color, int depth, SDL_Texture *texture = nullptr) {
+            int size = type == PrimitiveType::Sprite ? sprites.size() : vertices.size();
+            if (!commands.empty()) {
+                DrawCommand &last = commands.back();
+                if (last.type == type && last.color == color && last.depth == depth && last.texture == texture &&
+                    type != PrimitiveType::Polyline && type != PrimitiveType::Texture &&
+                    last.first + last.count == size) {
+                    return last;
+                }
+            }
+            commands.push_back({type, color, depth, size, 0, texture});
+            return commands.back();
+        }
+
+        static SDL_Color unpack(uint32_t color) {
+            SDL_Color c;
+            c.r = color >> 24;
+            c.g = color >> 16;
+            c.b = color >> 8;
+            c.a = color;
+            return c;
+        }
+
+        static void setColor(SDL_Renderer *renderer, uint32_t color) {
+            SDL_Color c = unpack(color);
+            SDL_SetRenderDrawColor(renderer, c.r, c.g, c.b, c.a);
+        }
+
+        /// The batch a primitive type is submitted in, within one depth.
+        static int batch(PrimitiveType type) {
+            switch (type) {
+                case PrimitiveType::Texture: return 0;
+                case PrimitiveType::Lines:
+                case PrimitiveType::Polyline: return 1;
+                case PrimitiveType::Sprite: return 2;
+                default: return 3;
+            }
+        }
+
+        /// Sort the commands by depth, farthest first, then by batch and color.
+        void sort() {
+            order.resize(commands.size());
+            for (int i = 0; i < order.size(); i++) order[i] = i;
+            std::sort(order.begin(), order.end(), [this](int i, int j) {
+                const DrawCommand &a = commands[i];
+                const DrawCommand &b = commands[j];
+                if (a.depth != b.depth) return a.depth > b.depth;
+                if (batch(a.type) != batch(b.type)) return batch(a.type) < batch(b.type);
+                if (a.texture != b.texture) return a.texture < b.texture;
+                if (a.color != b.color) return a.color < b.color;
+                return i < j;
+            });
+        }
+
+        /// Append a one pixel wide quad covering a segment to the geometry batch.
+        void segment(SDL_FPoint a, SDL_FPoint b, SDL_Color color) {
+            // Pixel centers are at half coordinates, and the quad is
+            // one pixel wide, extended by half a pixel at both ends.
+            float dx = b.x - a.x, dy = b.y - a.y;
+            float length = std::sqrt(dx * dx + dy * dy);
+            float ux = length > 0 ? 0.5f * dx / length : 0.5f;
+            float uy = length > 0 ? 0.5f * dy / length : 0;
+            float ax = a.x + 0.5f - ux, ay = a.y + 0.5f - uy;
+            float bx = b.x + 0.5f + ux, by = b.y + 0.5f + uy;
+            int base = geometry.size();
+            geometry.push_back({{ax - uy, ay + ux}, color, {0, 0}});
+            geometry.push_back({{ax + uy, ay - ux}, color, {0, 0}});
+            geometry.push_back({{bx + uy, by - ux}, color, {0, 0}});
+            geometry.push_back({{bx - uy, by + ux}, color, {0, 0}});
+            indices.push_back(base);
+            indices.push_back(base + 1);
+            indices.push_back(base + 2);
+            indices.push_back(base);
+            indices.push_back(base + 2);
+            indices.push_back(base + 3);
+        }
+
+        /// Submit the sorted commands [begin, end), which are all lines and polylines, as one geometry batch.
+        /// The segments are gathered into arrays and clipped to the viewport in one pass before any geometry is built.
+        void flushLines(SDL_Renderer *renderer, int begin, int end) {
+            x0.clear(); y0.clear(); x1.clear(); y1.clear();
+            colors.clear();
+            for (int c = begin; c < end; c++) {
+                DrawCommand &command = commands[order[c]];
+                int last = command.first + command.count;
+                int stride = command.type == PrimitiveType::Lines ? 2 : 1;
+                for (int i = command.first; i + 1 < last; i += stride) {
+                    x0.push_back(vertices[i].x);
+                    y0.push_back(vertices[i].y);
+                    x1.push_back(vertices[i + 1].x);
+                    y1.push_back(vertices[i + 1].y);
+                    colors.push_back(command.color);
+                }
+            }
+            int n = x0.size();
+            if (viewport.w > 0 && viewport.h > 0) {
+                // Clip to a slightly larger rectangle, so the line quads
+                // still cover the pixels on the edges of the viewport.
+                SDL_FRect rect = {viewport.x - 2, viewport.y - 2, viewport.w + 4, viewport.h + 4};
+                n = clipSegments(x0.data(), y0.data(), x1.data(), y1.data(), colors.data(), n, rect);
+            }
+            geometry.clear();
+            indices.clear();
+            for (int i = 0; i < n; i++) {
+                segment({x0[i], y0[i]}, {x1[i], y1[i]}, unpack(colors[i]));
+            }
+            if (!geometry.empty()) {
+                SDL_RenderGeometry(renderer, NULL, geometry.data(), geometry.size(), indices.data(), indices.size());
+            }
+        }
+
+        /// Submit the sorted commands [begin, end), which are all sprites of one texture, as one geometry batch.
+        void flushSprites(SDL_Renderer *renderer, int begin, int end) {
+            geometry.clear();
+            indices.clear();
+            for (int c = begin; c < end; c++) {
+                DrawCommand &command = commands[order[c]];
+                SDL_Color color = unpack(command.color);
+                for (int i = command.first; i < command.first + command.count; i++) {
+                    SDL_FRect &d = sprites[i].destination;
+                    SDL_FRect &s = sprites[i].source;
+                    int base = geometry.size();
+                    geometry.push_back({{d.x, d.y}, color, {s.x, s.y}});
+                    geometry.push_back({{d.x + d.w, d.y}, color, {s.x + s.w, s.y}});
+                    geometry.push_back({{d.x + d.w, d.y + d.h}, color, {s.x + s.w, s.y + s.h}});
+                    geometry.push_back({{d.x, d.y + d.h}, color, {s.x, s.y + s.h}});
+                    indices.push_back(base);
+                    indices.push_back(base + 1);
+                    indices.push_back(base + 2);
+                    indices.push_back(base);
+                    indices.push_back(base + 2);
+                    indices.push_back(base + 3);
+                }
+            }
+            if (!geometry.empty()) {
+                SDL_RenderGeometry(renderer, commands[order[begin]].texture, geometry.data(), geometry.size(),
+                                   indices.data(), indices.size());
+            }
+        }
+
+        /// Submit the sorted commands [begin, end), which are all points of one color, in one call.
+        /// Points outside the viewport are dropped, so only coordinates on the screen reach SDL.
+        void flushPoints(SDL_Renderer *renderer, int begin, int end) {
+            setColor(renderer, commands[order[begin]].color);
+            bool clip = viewport.w > 0 && viewport.h > 0;
+            float left = viewport.x - 1, top = viewport.y - 1;
+            float right = viewport.x + viewport.w + 1, bottom = viewport.y + viewport.h + 1;
+            points.clear();
+            for (int c = begin; c < end; c++) {
+                DrawCommand &command = commands[order[c]];
+                for (int i = command.first; i < command.first + command.count; i++) {
+                    SDL_FPoint &p = vertices[i];
+                    if (clip && !(p.x >= left && p.x <= right && p.y >= top && p.y <= bottom)) continue;
+                    points.push_back(p);
+                }
+            }
+            if (!points.empty()) SDL_RenderDrawPointsF(renderer, points.data(), points.size());
+        }
+
+    public:
+        /// @brief The vertices of all recorded primitives, in pixels.
+        std::vector<SDL_FPoint> vertices;
+        /// @brief The recorded commands, in the order they were recorded.
+        std::vector<DrawCommand> commands;
+        /// @brief The textures of all texture commands.
+        std::vector<TextureCopy> textures;
+        /// @brief The rectangles of all sprite commands.
+        std::vector<SpriteQuad> sprites;
+        /// @brief The rectangle lines and points are clipped to, in pixels. Nothing is clipped if it is empty.
+        SDL_FRect viewport = {0, 0, 0, 0};
+        /// @brief The most segments the outline of a circle is recorded with.
+        int circleSegments = 1024;
+
+        /// @brief Remove all recorded primitives.
+        void clear() {
+            vertices.clear();
+            commands.clear();
+            textures.clear();
+            sprites.clear();
+        }
+
+        /// @brief Append the primitives recorded in another queue.
+        /// @details The commands are copied with their first indices moved past
+        /// the primitives already in this queue. Queues recorded on different
+        /// threads are merged this way before they are flushed, and since the
+        /// flush sorts by depth, the order they are appended in does not matter.
+        void append(const RenderQueue &other) {
+            int firstVertex = vertices.size();
+            int firstTexture = textures.size();
+            int firstSprite = sprites.size();
+            for (int i = 0; i < other.commands.size(); i++) {
+                DrawCommand command = other.commands[i];
+                if (command.type == PrimitiveType::Texture) command.first += firstTexture;
+                else if (command.type == PrimitiveType::Sprite) command.first += firstSprite;
+                else command.first += firstVertex;
+                commands.push_back(command);
+            }
+            vertices.insert(vertices.end(), other.vertices.begin(), other.vertices.end());
+            textures.insert(textures.end(), other.textures.begin(), other.textures.end());
+            sprites.insert(sprites.end(), other.sprites.begin(), other.sprites.end());
+        }
+
+        /// @brief Record a line segment.
+        void line(SDL_FPoint a, SDL_FPoint b, uint32_t color, int depth) {
+            DrawCommand &c = command(PrimitiveType::Lines, color, depth);
+            vertices.push_back(a);
+            vertices.push_back(b);
+            c.count += 2;
+        }
+
+        /// @brief Record a chain of connected line segments.
+        /// @param points The vertices of the chain.
+        /// @param n The number of vertices.
+        /// @param closed Whether to connect the last vertex back to the first.
+        void polyline(const SDL_FPoint *points, int n, bool closed, uint32_t color, int depth) {
+            if (n < 2) return;
+            DrawCommand &c = command(PrimitiveType::Polyline, color, depth);
+            vertices.insert(vertices.end(), points, points + n);
+            if (closed) vertices.push_back(points[0]);
+            c.count = n + (closed ? 1 : 0);
+        }
+
+        /// @brief Record a single pixel.
+        void point(SDL_FPoint p, uint32_t color, int depth) {
+            DrawCommand &c = command(PrimitiveType::Points, color, depth);
+            vertices.push_back(p);
+            c.count++;
+        }
+
+        /// @brief Record the outline of a circle as a polyline.
+        /// @details The outline gets as many segments as keep it within a
+        /// quarter of a pixel of the circle, up to circleSegments. Of a circle
+        /// whose center is outside the viewport only the arc facing the
+        /// viewport is recorded, with all segments spread over it, and a circle
+        /// that misses the viewport is not recorded at all. The outline is a
+        /// line like any other, so it is clipped to the viewport when flushed.
+        void circle(SDL_FPoint center, float radius, uint32_t color, int depth) {
+            if (!(radius > 0)) return;
+            float start = 0;
+            float sweep = 2 * M_PI;
+            bool closed = true;
+            if (viewport.w > 0 && viewport.h > 0) {
+                float left = viewport.x - 2, top = viewport.y - 2;
+                float right = viewport.x + viewport.w + 2, bottom = viewport.y + viewport.h + 2;
+                float nx = std::min(std::max(center.x, left), right) - center.x;
+                float ny = std::min(std::max(center.y, top), bottom) - center.y;
+                float fx = std::max(std::fabs(left - center.x), std::fabs(right - center.x));
+                float fy = std::max(std::fabs(top - center.y), std::fabs(bottom - center.y));
+                // The circle is either entirely outside of the viewport or around it.
+                if (radius * radius < nx * nx + ny * ny || radius * radius > fx * fx + fy * fy) return;
+                if (nx != 0 || ny != 0) {
+                    // Seen from outside, the viewport spans less than half a
+                    // turn, so the angles of its corners are measured from the
+                    // direction to its middle and do not wrap around.
+                    float middle = std::atan2(0.5f * (top + bottom) - center.y, 0.5f * (left + right) - center.x);
+                    float low = M_PI, high = -M_PI;
+                    for (int corner = 0; corner < 4; corner++) {
+                        float x = (corner & 1 ? right : left) - center.x;
+                        float y = (corner & 2 ? bottom : top) - center.y;
+                        float angle = std::remainder(std::atan2(y, x) - middle, (float)(2 * M_PI));
+                        low = std::min(low, angle);
+                        high = std::max(high, angle);
+                    }
+                    start = middle + low;
+                    sweep = high - low;
+                    closed = false;
+                }
+            }
+            // A segment spanning an angle a strays r (1 - cos(a / 2)) from the circle.
+            float angle = 2 * std::acos(std::max(1 - 0.25f / radius, -1.0f));
+            float wanted = std::ceil(sweep / std::max(angle, 1e-6f));
+            int segments = std::min(std::max(wanted, 8.0f), (float)circleSegments);
+            int n = closed ? segments : segments + 1;
+            DrawCommand &c = command(PrimitiveType::Polyline, color, depth);
+            c.count = n + (closed ? 1 : 0);
+            for (int i = 0; i < n; i++) {
+                float a = start + sweep * i / segments;
+                vertices.push_back({center.x + radius * std::cos(a), center.y + radius * std::sin(a)});
+            }
+            if (closed) vertices.push_back(vertices[c.first]);
+        }
+
+        /// @brief Record a rectangle of a texture, tinted by a color.
+        /// @param texture The texture.
+        /// @param destination The rectangle on the screen, in pixels.
+        /// @param source The rectangle in the texture, as texture coordinates.
+        void sprite(SDL_Texture *texture, SDL_FRect destination, SDL_FRect source, uint32_t color, int depth) {
+            DrawCommand &c = command(PrimitiveType::Sprite, color, depth, texture);
+            sprites.push_back({destination, source});
+            c.count++;
+        }
+
+        /// @brief Record a texture copied to a rectangle on the screen.
+        void texture(SDL_Texture *texture, SDL_FRect rect, int depth) {
+            commands.push_back({PrimitiveType::Texture, 0xFFFFFFFF, depth, (int)textures.size(), 0, texture});
+            textures.push_back({texture, rect});
+        }
+
+        /// @brief Submit all recorded primitives to a renderer, farthest depth first.
+        void flush(SDL_Renderer *renderer) {
+            sort();
+            int c = 0;
+            while (c < order.size()) {
+                DrawCommand &command = commands[order[c]];
+                int kind = batch(command.type);
+                int end = c + 1;
+                while (end < order.size()) {
+                    DrawCommand &next = commands[order[end]];
+                    if (next.depth != command.depth || batch(next.type) != kind) break;
+                    if (kind == 2 && next.texture != command.texture) break;
+                    if (kind == 3 && next.color != command.color) break;
+                    end++;
+                }
+                if (kind == 0) {
+                    for (int i = c; i < end; i++) {
+                        TextureCopy &copy = textures[commands[order[i]].first];
+                        SDL_RenderCopyF(renderer, copy.texture, NULL, &copy.rect);
+                    }
+                } else if (kind == 1) {
+                    flushLines(renderer, c, end);
+                } else if (kind == 2) {
+                    flushSprites(renderer, c, end);
+                } else {
+                    flushPoints(renderer, c, end);
+                }
+                c = end;
+            }
+        }
+};
+
+#endif
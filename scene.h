@@ -0,0 +1,69 @@
+#ifndef SCENE_H
+#define SCENE_H
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <functional>
+
+class Drawable;
+
+/// @brief The drawables of one camera, bucketed by depth.
+/// @details Buckets are kept in an ordered map from depth to the drawables
+/// of that depth, farthest first, so iterating the buckets visits drawables
+/// in drawing order. Every drawable remembers its slot in its bucket, so it is
+/// removed by moving the last drawable of the bucket into the slot. Adding
+/// and removing cost one map lookup, independent of the number of drawables,
+/// and the order within a depth is not kept.
+class Scene {
+    private:
+        struct Slot {
+            int depth;
+            int index;
+        };
+        std::unordered_map<Drawable*, Slot> slots;
+
+    public:
+        /// @brief The drawables of every depth, farthest depth first.
+        std::map<int, std::vector<Drawable*>, std::greater<int>> buckets;
+
+        /// @brief Add a drawable.
+        /// @param drawable The drawable.
+        /// @param depth The depth of the drawable. Changing the depth later requires removing and adding it again.
+        /// @return False if the drawable was already in the scene.
+        bool add(Drawable *drawable, int depth) {
+            if (slots.count(drawable) > 0) return false;
+            std::vector<Drawable*> &bucket = buckets[depth];
+            slots[drawable] = {depth, (int)bucket.size()};
+            bucket.push_back(drawable);
+            return true;
+        }
+
+        /// @brief Remove a drawable.
+        /// @return False if the drawable was not in the scene.
+        bool remove(Drawable *drawable) {
+            auto found = slots.find(drawable);
+            if (found == slots.end()) return false;
+            Slot slot = found->second;
+            slots.erase(found);
+            std::vector<Drawable*> &bucket = buckets[slot.depth];
+            Drawable *last = bucket.back();
+            bucket.pop_back();
+            if (last != drawable) {
+                bucket[slot.index] = last;
+                slots[last].index = slot.index;
+            }
+            return true;
+        }
+
+        /// @brief Check whether a drawable is in the scene.
+        bool contains(Drawable *drawable) {
+            return slots.count(drawable) > 0;
+        }
+
+        /// @brief Get the number of drawables in the scene.
+        int size() {
+            return slots.size();
+        }
+};
+
+#endif
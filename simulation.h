@@ -0,0 +1,272 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+#include "physics.h"
+#include "collision.h"
+#include "prediction.h"
+#include "ephemeris.h"
+#include "triplebuffer.h"
+#include "taskgraph.h"
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <climits>
+
+/// @brief The state of the simulation after one tick, as seen by the renderer.
+struct SimulationSnapshot {
+    PhysicsWorld world;
+    /// @brief The predicted paths of all bodies.
+    Propagation propagation;
+    /// @brief The ephemerides fitted to the propagation.
+    EphemerisSet ephemeris;
+    /// @brief The sample times of the events along the predicted trajectory of the tracked body.
+    std::vector<float> events;
+    /// @brief Whether the predicted trajectory is a closed orbit.
+    bool closed = false;
+    int trackedBody = 0;
+    /// @brief The index every body of the initial world has now. Merged bodies share an index.
+    std::vector<int> bodyIndex;
+};
+
+/// @brief Runs the physics and the prediction on a thread of their own.
+/// @details After every tick the simulation publishes a snapshot of its state
+/// through a TripleBuffer, and the renderer takes the latest snapshot whenever
+/// it draws a frame. Neither thread waits for the other, so a slow frame does
+/// not slow the physics down and a slow prediction does not stall the window.
+/// The renderer never touches the state of the simulation itself.
+///
+/// Every step is a small TaskGraph on the thread pool, and consecutive steps
+/// are pipelined: the physics of a tick only depends on the previous tick,
+/// so it runs in parallel with the prediction and publication of the previous
+/// tick, which work on a copy of its world. Snapshots are therefore one tick
+/// behind the physics.
+///
+/// Where no thread can be spared, the simulation can instead be sliced: the
+/// renderer calls update() once per frame, which ticks the physics and
+/// continues the prediction for a fixed time budget. A prediction that does
+/// not fit in one frame is resumed in the next one, and is published while it
+/// grows as long as it reaches further than the last complete prediction.
+class Simulation {
+    private:
+        float strength;
+        CollisionSystem collisions;
+        std::vector<int> bodyIndex;
+        std::thread thread;
+        std::atomic<bool> running{false};
+        TaskGraph graph;
+        /// The time step of the tick being simulated.
+        float dt = 0;
+        /// The state of the previous tick, waiting to be predicted and published.
+        PhysicsWorld staged;
+        std::vector<int> stagedIndex;
+        int stagedBody = 0;
+        /// The reference body set on the predictor, or -1, renumbered by merges like trackedBody.
+        int reference = -1;
+        int stagedReference = -1;
+        /// Whether the staged state was not published yet.
+        bool pending = false;
+        /// The time of the last call to update().
+        std::chrono::steady_clock::time_point last;
+        /// The last complete prediction, published while the next one is computed in slices.
+        SimulationSnapshot latest;
+        bool hasLatest = false;
+        EphemerisSet none;
+
+        /// Advance the world by the time step.
+        void tick() {
+            world.update(dt);
+            if (collisions.resolve(world, dt) > 0) {
+                // Merging moves bodies around in the vector.
+                trackedBody = collisions.remap[trackedBody];
+                if (reference >= 0) reference = collisions.remap[reference];
+                for (int i = 0; i < bodyIndex.size(); i++) {
+                    bodyIndex[i] = collisions.remap[bodyIndex[i]];
+                }
+            }
+            applyGravitationalForces(strength, world);
+        }
+
+        /// Copy the state of the last tick for the prediction.
+        void stage() {
+            staged = world;
+            stagedIndex = bodyIndex;
+            stagedBody = trackedBody;
+            stagedReference = reference;
+            pending = true;
+        }
+
+        /// Start predicting the trajectory of the tracked body in the staged world.
+        /// @return Whether the prediction is already complete.
+        bool begin() {
+            predictor.trackedBody = stagedBody;
+            predictor.reference = stagedReference;
+            predictor.watchAll(stagedBody, staged.bodies.size());
+            return predictor.start(staged);
+        }
+
+        /// Predict the trajectory of the tracked body in the staged world.
+        void predict() {
+            if (!begin()) predictor.resume(INT_MAX);
+            if (!predictor.reused) {
+                ephemeris.fit(predictor.propagation, 0.25f);
+            } else {
+                ephemeris.translate(predictor.shift);
+            }
+        }
+
+        /// Copy the prediction, as far as it got, into a snapshot.
+        void writePrediction(SimulationSnapshot &snapshot, EphemerisSet &fit) {
+            snapshot.propagation = predictor.propagation;
+            snapshot.ephemeris = fit;
+            snapshot.events.clear();
+            for (int i = 0; i < predictor.events.size(); i++) {
+                snapshot.events.push_back(predictor.events[i].sampleTime);
+            }
+            snapshot.closed = !predictor.inProgress() && predictor.end == PredictionEnd::Closed;
+        }
+
+        /// Copy the staged state and its prediction into the back slot of the snapshots and publish it.
+        void publish() {
+            SimulationSnapshot &snapshot = snapshots.write();
+            snapshot.world = staged;
+            writePrediction(snapshot, ephemeris);
+            snapshot.trackedBody = stagedBody;
+            snapshot.bodyIndex = stagedIndex;
+            snapshots.publish();
+            pending = false;
+        }
+
+        /// Build the graph of one step: the tick runs alongside the
+        /// prediction of the previous tick, and its state is staged once both are done.
+        void buildGraph() {
+            graph.clear();
+            int physics = graph.add([this] { tick(); });
+            int prediction = graph.add([this] { if (pending) predict(); });
+            int publication = graph.add([this] { if (pending) publish(); }, {prediction});
+            graph.add([this] { stage(); }, {physics, publication});
+        }
+
+        void run() {
+            auto last = std::chrono::steady_clock::now();
+            while (running) {
+                auto now = std::chrono::steady_clock::now();
+                float dt = std::chrono::duration<float>(now - last).count();
+                last = now;
+                if (!paused) {
+                    this->dt = dt;
+                    graph.run();
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(interval));
+            }
+        }
+
+    public:
+        /// @brief The world being simulated. Only touch it before start().
+        PhysicsWorld world;
+        /// @brief The predictor of the trajectory of the tracked body. Configure it before start().
+        /// @details Its reference body, if one is set, is renumbered along with the bodies when they merge.
+        Predictor predictor;
+        EphemerisSet ephemeris;
+        /// @brief The body whose trajectory is predicted. Only touch it before start(); afterwards it is in the snapshots.
+        int trackedBody = 0;
+        /// @brief The latest state of the simulation, for the renderer.
+        TripleBuffer<SimulationSnapshot> snapshots;
+        /// @brief Whether the simulation is paused. The renderer may change this at any time.
+        std::atomic<bool> paused{false};
+        /// @brief The time the thread sleeps after every tick, in milliseconds.
+        int interval = 5;
+        /// @brief Whether the simulation runs on the thread that calls update() instead of a thread of its own.
+        /// @details Set this before start().
+        bool sliced = false;
+        /// @brief The most time update() spends on the prediction, in seconds.
+        float budget = 0.004f;
+
+        /// @brief Create a simulation.
+        /// @param strength The magnitude of the gravitational force between two bodies at unit distance.
+        Simulation(float strength) : predictor(strength) {
+            this->strength = strength;
+        }
+
+        ~Simulation() {
+            stop();
+        }
+
+        /// @brief Publish the initial state and start the thread.
+        /// @details The first snapshot is published before this returns, so
+        /// the renderer has a state to draw right away. A sliced simulation
+        /// only starts its first prediction and publishes what fits in the budget.
+        void start() {
+            if (running) return;
+            bodyIndex.resize(world.bodies.size());
+            for (int i = 0; i < bodyIndex.size(); i++) bodyIndex[i] = i;
+            reference = predictor.reference;
+            stage();
+            if (sliced) {
+                begin();
+                last = std::chrono::steady_clock::now();
+                update();
+                return;
+            }
+            predict();
+            publish();
+            buildGraph();
+            running = true;
+            thread = std::thread([this] { run(); });
+        }
+
+        /// @brief Tick the physics and continue the prediction on the calling thread, for a sliced simulation.
+        /// @details The prediction runs from a staged copy of the world. Once
+        /// it is complete, it is kept as the latest prediction and the next
+        /// one starts from the current world. Every call publishes the current
+        /// world with the latest prediction, or with the one in progress once
+        /// it has more samples.
+        void update() {
+            auto now = std::chrono::steady_clock::now();
+            float dt = std::chrono::duration<float>(now - last).count();
+            last = now;
+            if (paused) return;
+            this->dt = dt;
+            tick();
+            // A merge renumbers the bodies, so a prediction of the world before it is started over.
+            if (stagedIndex != bodyIndex) {
+                stage();
+                begin();
+            }
+            bool complete = predictor.resume(INT_MAX, budget);
+            if (complete) {
+                if (!predictor.reused) ephemeris.fit(predictor.propagation, 0.25f);
+                else ephemeris.translate(predictor.shift);
+                writePrediction(latest, ephemeris);
+                hasLatest = true;
+            }
+
+            SimulationSnapshot &snapshot = snapshots.write();
+            snapshot.world = world;
+            snapshot.trackedBody = trackedBody;
+            snapshot.bodyIndex = bodyIndex;
+            if (!complete && (!hasLatest || predictor.propagation.size() > latest.propagation.size())) {
+                // The samples are shown without ephemerides until the prediction is complete.
+                writePrediction(snapshot, none);
+            } else {
+                snapshot.propagation = latest.propagation;
+                snapshot.ephemeris = latest.ephemeris;
+                snapshot.events = latest.events;
+                snapshot.closed = latest.closed;
+            }
+            snapshots.publish();
+
+            if (complete) {
+                stage();
+                begin();
+            }
+        }
+
+        /// @brief Stop the thread after its current tick.
+        void stop() {
+            if (!running) return;
+            running = false;
+            thread.join();
+        }
+};
+
+#endif
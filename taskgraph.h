@@ -0,0 +1,79 @@
+#ifndef TASKGRAPH_H
+#define TASKGRAPH_H
+#include "threadpool.h"
+#include <vector>
+#include <memory>
+#include <functional>
+#include <atomic>
+
+/// @brief A set of tasks with dependencies between them, run on the thread pool.
+/// @details Every task is queued on the pool as soon as all tasks it depends on
+/// are done, so independent tasks run in parallel and a task never waits for
+/// work it does not need. A graph can be run any number of times; it is built
+/// once per kind of frame and cleared when its shape changes.
+class TaskGraph {
+    private:
+        struct Task {
+            std::function<void()> function;
+            std::vector<int> dependents;
+            int dependencies = 0;
+            std::atomic<int> remaining{0};
+        };
+        std::vector<std::unique_ptr<Task>> tasks;
+        std::atomic<int> unfinished{0};
+
+        void launch(ThreadPool &pool, int index) {
+            pool.submit([this, &pool, index] {
+                Task &task = *tasks[index];
+                task.function();
+                for (int i = 0; i < task.dependents.size(); i++) {
+                    int next = task.dependents[i];
+                    if (--tasks[next]->remaining == 0) launch(pool, next);
+                }
+                if (--unfinished == 0) pool.wake();
+            });
+        }
+
+    public:
+        /// @brief Add a task.
+        /// @param function The work of the task.
+        /// @param dependencies The tasks that have to be done before this one starts.
+        /// @return The index of the task, for the dependencies of later tasks.
+        int add(std::function<void()> function, std::vector<int> dependencies = {}) {
+            int index = tasks.size();
+            tasks.push_back(std::make_unique<Task>());
+            Task &task = *tasks.back();
+            task.function = std::move(function);
+            task.dependencies = dependencies.size();
+            for (int i = 0; i < dependencies.size(); i++) {
+                tasks[dependencies[i]]->dependents.push_back(index);
+            }
+            return index;
+        }
+
+        /// @brief Remove all tasks.
+        void clear() {
+            tasks.clear();
+        }
+
+        /// @brief Get the number of tasks.
+        int size() {
+            return tasks.size();
+        }
+
+        /// @brief Run all tasks and return once they are done.
+        /// @param pool The pool to run the tasks on.
+        /// @details The calling thread runs queued jobs while it waits, and sleeps when there are none.
+        void run(ThreadPool &pool = ThreadPool::global()) {
+            unfinished = tasks.size();
+            for (int i = 0; i < tasks.size(); i++) {
+                tasks[i]->remaining = tasks[i]->dependencies;
+            }
+            for (int i = 0; i < tasks.size(); i++) {
+                if (tasks[i]->dependencies == 0) launch(pool, i);
+            }
+            pool.helpUntil([this] { return unfinished == 0; });
+        }
+};
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef TESSELLATION_H
+#define TESSELLATION_H
+#include "Vector2D.h"
+#include <vector>
+#include <cmath>
+
+/// @brief Turns a continuous curve into a polyline that looks smooth on the screen.
+/// @details The curve is split into a number of initial pieces, and each
+/// piece is halved until the midpoint of the curve is closer to the chord than
+/// the tolerance, measured in pixels at the scale the polyline is drawn at.
+/// Straight stretches end up with few segments and tight turns with many, and
+/// zooming in refines the polyline where it is needed. The error does not
+/// depend on where the view is or how it is rotated, so one polyline serves
+/// every view of the curve at the same or a smaller scale.
+class AdaptiveTessellator {
+    private:
+        template <typename Curve>
+        void subdivide(float limit, Curve &curve, float t0, Vector2D p0,
+                       float t1, Vector2D p1, int depth, std::vector<Vector2D> &points) {
+            float tm = 0.5f * (t0 + t1);
+            Vector2D pm = curve(tm);
+            Vector2D chord = p1 - p0;
+            Vector2D offset = pm - p0;
+            float length = chord.magnitude();
+            float error = length > 0
+                    ? std::fabs(chord.x * offset.y - chord.y * offset.x) / length
+                    : offset.magnitude();
+            if (depth < maxDepth && (depth < minDepth || error > limit)) {
+                subdivide(limit, curve, t0, p0, tm, pm, depth + 1, points);
+                subdivide(limit, curve, tm, pm, t1, p1, depth + 1, points);
+                return;
+            }
+            points.push_back(p1);
+        }
+
+    public:
+        /// @brief The largest distance between the curve and the polyline, in pixels.
+        float tolerance = 0.5f;
+        /// @brief The number of times every initial piece is halved at least.
+        int minDepth = 1;
+        /// @brief The number of times every initial piece is halved at most.
+        int maxDepth = 12;
+
+        /// @brief Tessellate a curve.
+        /// @param scale The number of pixels per unit of length the polyline will be drawn at.
+        /// @param curve A function returning the position of the curve at a parameter.
+        /// @param start The parameter at which the curve starts.
+        /// @param end The parameter at which the curve ends.
+        /// @param pieces The number of pieces the curve is split into before refining.
+        /// @param points The positions of the polyline vertices are appended to this.
+        template <typename Curve>
+        void tessellate(float scale, Curve curve, float start, float end, int pieces, std::vector<Vector2D> &points) {
+            if (pieces < 1 || end <= start || !(scale > 0)) return;
+            float limit = tolerance / scale;
+            float step = (end - start) / pieces;
+            Vector2D p0 = curve(start);
+            points.push_back(p0);
+            for (int i = 0; i < pieces; i++) {
+                float t1 = i + 1 == pieces ? end : start + (i + 1) * step;
+                Vector2D p1 = curve(t1);
+                subdivide(limit, curve, start + i * step, p0, t1, p1, 0, points);
+                p0 = p1;
+            }
+        }
+};
+
+#endif
@@ -0,0 +1,767 @@
+// Behaviour checks of the numerical and threading building blocks. It is built
+// like main.cpp, from this single file, and needs no window:
+//   g++ -std=c++17 -O2 tests.cpp -lSDL2 -lpthread -o tests && ./tests
+// Every failed check is printed, and the exit code is the number of failures.
+#include "collision.h"
+#include "prediction.h"
+#include "ephemeris.h"
+#include "renderqueue.h"
+#include "triplebuffer.h"
+#include "taskgraph.h"
+#include "simulation.h"
+#include "threadpool.h"
+#include "corotating.h"
+#include "relative.h"
+#include "potential.h"
+#include "transform.h"
+#include "graphics.h"
+#include "tessellation.h"
+#include <cstdio>
+#include <cmath>
+#include <thread>
+#include <atomic>
+#include <vector>
+
+int failures = 0;
+
+void check(bool condition, const char *what) {
+    if (condition) return;
+    std::printf("FAILED: %s\n", what);
+    failures++;
+}
+
+bool near(float a, float b, float tolerance) {
+    return std::fabs(a - b) <= tolerance;
+}
+
+// Two bodies approach head on and touch at a known fraction of the step
+void testSweptCircles() {
+    // Radius is the mass, so the bodies touch when their centers are 2 apart.
+    // They start 10 apart, close at 16 per second over a step of one second,
+    // and so touch after 8 / 16 = 0.5 of the step.
+    PhysicsBody a(Vector2D(3, 0), Vector2D(8, 0), 1);
+    PhysicsBody b(Vector2D(-3, 0), Vector2D(-8, 0), 1);
+    float time = -1;
+    check(CollisionSystem::sweptCircles(a, b, 1, time), "swept circles that cross touch");
+    check(near(time, 0.5f, 1e-4f), "swept circles touch at the analytic time");
+
+    // The same bodies moving apart never touch.
+    PhysicsBody c(Vector2D(-13, 0), Vector2D(-8, 0), 1);
+    PhysicsBody d(Vector2D(13, 0), Vector2D(8, 0), 1);
+    check(!CollisionSystem::sweptCircles(c, d, 1, time), "separating circles do not touch");
+
+    // A pass that misses by more than the radii does not touch either.
+    PhysicsBody e(Vector2D(8, 0), Vector2D(16, 0), 1);
+    PhysicsBody f(Vector2D(0, 3), Vector2D(0, 0), 1);
+    check(!CollisionSystem::sweptCircles(e, f, 1, time), "circles passing apart do not touch");
+
+    // Overlapping at the start of the step counts as touching right away.
+    PhysicsBody g(Vector2D(1, 0), Vector2D(0, 0), 1);
+    PhysicsBody h(Vector2D(0, 0), Vector2D(0, 0), 1);
+    check(CollisionSystem::sweptCircles(g, h, 1, time) && time == 0, "overlapping circles touch at the start");
+}
+
+// Two colliding bodies become one that keeps their mass and momentum
+void testMerge() {
+    PhysicsWorld world;
+    world.addBody(PhysicsBody(Vector2D(100, 100), Vector2D(0, 0), 1));
+    world.addBody(PhysicsBody(Vector2D(3, 0), Vector2D(8, 0), 1));
+    world.addBody(PhysicsBody(Vector2D(-3, 0), Vector2D(-8, 0), 3));
+    CollisionSystem collisions;
+    check(collisions.resolve(world, 1) == 1, "one pair is merged");
+    check(world.bodies.size() == 2, "the merged body replaces the pair");
+    check(collisions.remap.size() == 3 && collisions.remap[0] == 0 &&
+          collisions.remap[1] == 1 && collisions.remap[2] == 1, "both merged bodies map to the lower index");
+    PhysicsBody &merged = world.bodies[1];
+    check(merged.mass == 4, "the merged body has the combined mass");
+    check(near(merged.velocity.x * merged.mass, 1 * 8 + 3 * -8, 1e-4f) && merged.velocity.y == 0, "momentum is conserved");
+    check(near(merged.position.x, (1 * 3 + 3 * -3) / 4.0f, 1e-4f), "the merged body is at the center of mass");
+    check(world.bodies[0].position.x == 100, "the body that did not collide is kept");
+
+    // A fast body sweeps over many cells of small bodies and hits one of them.
+    PhysicsWorld row;
+    for (int i = 0; i < 20; i++) {
+        row.addBody(PhysicsBody(Vector2D(i * 10, 0), Vector2D(0, 0), 1));
+    }
+    row.addBody(PhysicsBody(Vector2D(50, 50), Vector2D(0, 1000), 1));
+    check(collisions.resolve(row, 0.1f) == 1, "an oversized body is tested against the others");
+    check(row.bodies.size() == 20 && collisions.remap[20] == 5, "the oversized body merges into the one it hit");
+
+    // A merge in front of the reference body moves it to a lower index, and
+    // the predictor of a simulation follows it there.
+    Simulation simulation(66700000);
+    simulation.world.addBody(PhysicsBody(Vector2D(0, 0), Vector2D(0, 0), 1));
+    simulation.world.addBody(PhysicsBody(Vector2D(1, 0), Vector2D(0, 0), 1));
+    simulation.world.addBody(PhysicsBody(Vector2D(500, 0), Vector2D(0, 0), 10));
+    simulation.world.addBody(PhysicsBody(Vector2D(500, 200), Vector2D(200, 0), 1));
+    simulation.trackedBody = 3;
+    simulation.predictor.reference = 2;
+    simulation.predictor.steps = 10;
+    simulation.sliced = true;
+    simulation.start();
+    simulation.snapshots.update();
+    SimulationSnapshot &snapshot = simulation.snapshots.read();
+    check(snapshot.world.bodies.size() == 3 && snapshot.trackedBody == 2, "the overlapping bodies merged");
+    check(simulation.predictor.reference == 1, "the reference body of the predictor is renumbered");
+}
+
+// Sample a body moving on a circle of a given radius at unit angular velocity
+void sampleCircle(Propagation &propagation, float radius, float step, int samples) {
+    propagation.clear(1);
+    PhysicsWorld world;
+    world.addBody(PhysicsBody());
+    for (int i = 0; i < samples; i++) {
+        float t = i * step;
+        world.bodies[0].position = Vector2D(radius * std::cos(t), radius * std::sin(t));
+        world.bodies[0].velocity = Vector2D(-radius * std::sin(t), radius * std::cos(t));
+        propagation.addSample(t, world);
+    }
+}
+
+// Cubic Hermite interpolation is exact for cubics and within h^4 max|f''''| / 384 otherwise
+void testHermite() {
+    Propagation propagation;
+    propagation.clear(1);
+    PhysicsWorld world;
+    world.addBody(PhysicsBody());
+    float times[] = {0, 0.3f, 1, 1.2f, 2};
+    for (int i = 0; i < 5; i++) {
+        float t = times[i];
+        world.bodies[0].position = Vector2D(1 + 2 * t - t * t * t, 3 * t * t);
+        world.bodies[0].velocity = Vector2D(2 - 3 * t * t, 6 * t);
+        propagation.addSample(t, world);
+    }
+    float worst = 0;
+    for (int i = 0; i <= 100; i++) {
+        float t = 2 * i / 100.0f;
+        Vector2D position, velocity;
+        propagation.interpolate(0, t, position, velocity);
+        worst = std::max(worst, (position - Vector2D(1 + 2 * t - t * t * t, 3 * t * t)).magnitude());
+        worst = std::max(worst, (velocity - Vector2D(2 - 3 * t * t, 6 * t)).magnitude());
+    }
+    check(worst < 1e-4f, "Hermite interpolation reproduces a cubic");
+
+    // Every coordinate of the circle has a fourth derivative of at most the radius.
+    float radius = 100, step = 0.25f;
+    sampleCircle(propagation, radius, step, 40);
+    float bound = radius * std::pow(step, 4) / 384;
+    worst = 0;
+    for (int i = 0; i < 39 * 16; i++) {
+        float t = i * step / 16;
+        Vector2D position, velocity;
+        propagation.interpolate(0, t, position, velocity);
+        worst = std::max(worst, std::fabs(position.x - radius * std::cos(t)));
+        worst = std::max(worst, std::fabs(position.y - radius * std::sin(t)));
+    }
+    check(worst <= bound * 1.05f + 1e-4f, "Hermite interpolation error stays within its bound");
+}
+
+// The Chebyshev fit meets its tolerance, and its error estimate covers the real error
+void testChebyshev() {
+    Propagation propagation;
+    float radius = 100;
+    sampleCircle(propagation, radius, 0.05f, 400);
+    Ephemeris ephemeris;
+    float tolerance = 0.01f;
+    ephemeris.fit(propagation, 0, tolerance);
+    check(!ephemeris.empty(), "the fit has segments");
+    check(ephemeris.error <= tolerance, "the fit meets its tolerance");
+    float worst = 0;
+    for (int i = 0; i <= 4000; i++) {
+        float t = ephemeris.start + (ephemeris.end - ephemeris.start) * i / 4000;
+        Vector2D exact(radius * std::cos(t), radius * std::sin(t));
+        worst = std::max(worst, (ephemeris.position(t) - exact).magnitude());
+    }
+    // The samples are interpolated before fitting, so their own error adds to the fit's.
+    float hermite = radius * std::pow(0.05f, 4) / 384;
+    check(worst <= ephemeris.error + 2 * hermite + 1e-3f, "the real fit error is within the estimate");
+
+    // Moving the fit moves every position by the same offset.
+    Vector2D before = ephemeris.position(3);
+    ephemeris.translate(Vector2D(5, -2));
+    check((ephemeris.position(3) - before - Vector2D(5, -2)).magnitude() < 1e-3f, "a translated fit is offset");
+}
+
+// Periapses and apoapses found by bisection sit where the radial velocity is zero
+void testEventBisection() {
+    float strength = 66700000;
+    PhysicsWorld world;
+    world.addBody(PhysicsBody(Vector2D(0, 0), Vector2D(0, 0), 10));
+    world.addBody(PhysicsBody(Vector2D(0, -180), Vector2D(-500, 0), 1));
+    applyGravitationalForces(strength, world);
+    Predictor predictor(strength);
+    predictor.trackedBody = 1;
+    predictor.steps = 2000;
+    predictor.watchAll(1, 2);
+    predictor.predict(world);
+    Propagation &propagation = predictor.propagation;
+
+    int extremes = 0;
+    for (int i = 0; i < predictor.events.size(); i++) {
+        TrajectoryEvent &event = predictor.events[i];
+        if (event.type != EventType::Periapsis && event.type != EventType::Apoapsis) continue;
+        extremes++;
+        Vector2D p, v, q, w;
+        propagation.interpolate(event.body, event.sampleTime, p, v);
+        propagation.interpolate(event.other, event.sampleTime, q, w);
+        Vector2D r = p - q, u = v - w;
+        float rate = (r.x * u.x + r.y * u.y) / (r.magnitude() * u.magnitude());
+        check(std::fabs(rate) < 1e-3f, "the radial velocity vanishes at an apsis");
+        check(near(r.magnitude(), event.distance, 1e-2f * event.distance), "the event distance matches the states");
+
+        // Within the sample interval it was found in, the distance falls
+        // before a periapsis and grows after it, and the other way around at
+        // an apoapsis.
+        int sample = propagation.findInterval(event.sampleTime);
+        float step = propagation.times[sample + 1] - propagation.times[sample];
+        float sign = event.type == EventType::Periapsis ? 1 : -1;
+        for (int k = -1; k <= 1; k += 2) {
+            float t = event.sampleTime + k * 0.01f * step;
+            t = std::min(std::max(t, propagation.times[sample]), propagation.times[sample + 1]);
+            propagation.interpolate(event.body, sample, t, p, v);
+            propagation.interpolate(event.other, sample, t, q, w);
+            r = p - q;
+            u = v - w;
+            check(sign * k * (r.x * u.x + r.y * u.y) > 0, "the radial velocity changes sign at an apsis");
+        }
+    }
+    check(extremes >= 2, "a bound orbit has a periapsis and an apoapsis");
+}
+
+// Segments are dropped, kept or shortened to the rectangle, with their colors
+void testLiangBarsky() {
+    float x0[] = {10, -50, -50, 200, 50};
+    float y0[] = {10, 50, -10, 200, -50};
+    float x1[] = {90, 150, 150, 300, 50};
+    float y1[] = {90, 50, -10, 300, 150};
+    uint32_t colors[] = {1, 2, 3, 4, 5};
+    int n = clipSegments(x0, y0, x1, y1, colors, 5, {0, 0, 100, 100});
+    check(n == 3, "segments that miss the rectangle are dropped");
+    check(colors[0] == 1 && colors[1] == 2 && colors[2] == 5, "the colors stay with their segments");
+    check(x0[0] == 10 && y0[0] == 10 && x1[0] == 90 && y1[0] == 90, "a segment inside is kept");
+    check(near(x0[1], 0, 1e-4f) && near(x1[1], 100, 1e-4f) && y0[1] == 50 && y1[1] == 50,
+          "a horizontal segment is cut at both sides");
+    check(near(y0[2], 0, 1e-4f) && near(y1[2], 100, 1e-4f) && x0[2] == 50 && x1[2] == 50,
+          "a vertical segment is cut at the top and bottom");
+}
+
+// Appended commands point at their own vertices, textures and sprites
+void testAppend() {
+    RenderQueue first, second;
+    first.line({0, 0}, {1, 1}, 1, 0);
+    first.sprite(nullptr, {0, 0, 1, 1}, {0, 0, 1, 1}, 1, 0);
+    first.texture(nullptr, {0, 0, 1, 1}, 0);
+    SDL_FPoint points[] = {{5, 5}, {6, 6}, {7, 7}};
+    second.polyline(points, 3, false, 2, 1);
+    second.sprite(nullptr, {2, 2, 1, 1}, {0, 0, 1, 1}, 2, 1);
+    second.texture(nullptr, {3, 3, 1, 1}, 1);
+    int before = first.commands.size();
+    first.append(second);
+    check(first.commands.size() == before + 3, "every command is appended");
+    check(first.vertices.size() == 5 && first.sprites.size() == 2 && first.textures.size() == 2,
+          "the primitives are appended");
+    for (int i = before; i < first.commands.size(); i++) {
+        DrawCommand &command = first.commands[i];
+        if (command.type == PrimitiveType::Polyline) {
+            check(command.first == 2 && first.vertices[command.first].x == 5, "a polyline points past the old vertices");
+        } else if (command.type == PrimitiveType::Sprite) {
+            check(command.first == 1 && first.sprites[command.first].destination.x == 2, "a sprite points past the old sprites");
+        } else if (command.type == PrimitiveType::Texture) {
+            check(command.first == 1 && first.textures[command.first].rect.x == 3, "a texture points past the old textures");
+        }
+    }
+}
+
+// The reader sees the latest published value, never an older one
+void testTripleBuffer() {
+    TripleBuffer<int> buffer;
+    check(!buffer.update(), "nothing is read before the first publication");
+    buffer.write() = 1;
+    buffer.publish();
+    buffer.write() = 2;
+    buffer.publish();
+    check(buffer.update() && buffer.read() == 2, "the latest of several publications is read");
+    check(!buffer.update() && buffer.read() == 2, "a value is only taken once");
+
+    TripleBuffer<int> shared;
+    const int count = 100000;
+    std::thread writer([&shared] {
+        for (int i = 1; i <= count; i++) {
+            shared.write() = i;
+            shared.publish();
+        }
+    });
+    int last = 0;
+    bool ordered = true;
+    while (last < count) {
+        if (!shared.update()) continue;
+        ordered = ordered && shared.read() > last;
+        last = shared.read();
+    }
+    writer.join();
+    check(ordered, "values are read in the order they were published");
+}
+
+// Every task starts after the tasks it depends on are done
+void testTaskGraph() {
+    ThreadPool pool(3);
+    TaskGraph graph;
+    std::atomic<int> clock{0};
+    int finished[6];
+    // A diamond with a tail: 0 -> {1, 2, 3} -> 4 -> 5, and 5 also on 1.
+    std::vector<std::vector<int>> dependencies = {{}, {0}, {0}, {0}, {1, 2, 3}, {4, 1}};
+    for (int i = 0; i < dependencies.size(); i++) {
+        graph.add([&clock, &finished, i] { finished[i] = ++clock; }, dependencies[i]);
+    }
+    bool ordered = true;
+    for (int run = 0; run < 200; run++) {
+        graph.run(pool);
+        for (int i = 0; i < dependencies.size(); i++) {
+            for (int j = 0; j < dependencies[i].size(); j++) {
+                ordered = ordered && finished[dependencies[i][j]] < finished[i];
+            }
+        }
+    }
+    check(ordered, "tasks run after their dependencies");
+    check(clock == 200 * 6, "every task runs once per run");
+}
+
+// Two bodies on circular orbits about their barycenter
+void circularPair(PhysicsWorld &world, float strength, float separation, float primaryMass, float secondaryMass) {
+    // The force between two bodies does not depend on their masses, so their
+    // relative acceleration is strength / d^2 * (1 / m1 + 1 / m2) = w^2 d.
+    float omega = std::sqrt(strength / (separation * separation * separation) * (1 / primaryMass + 1 / secondaryMass));
+    float total = primaryMass + secondaryMass;
+    float r1 = separation * secondaryMass / total, r2 = separation * primaryMass / total;
+    world.addBody(PhysicsBody(Vector2D(-r1, 0), Vector2D(0, -omega * r1), primaryMass));
+    world.addBody(PhysicsBody(Vector2D(r2, 0), Vector2D(0, omega * r2), secondaryMass));
+}
+
+// In the co-rotating frame a circular pair stands still, because the fictitious
+// accelerations cancel gravity
+void testCorotatingFrame() {
+    float strength = 66700000;
+    PhysicsWorld world;
+    circularPair(world, strength, 200, 10, 1);
+    CorotatingFrame frame;
+    frame.update(world);
+    applyGravitationalForces(strength, world);
+    for (int i = 0; i < 2; i++) {
+        CorotatingStates &states = frame.states;
+        check(near(states.vx[i], 0, 1e-2f) && near(states.vy[i], 0, 1e-2f), "the pair does not move in the frame");
+        Vector2D gravity = world.bodies[i].acceleration;
+        float gx = frame.cosine * gravity.x + frame.sine * gravity.y;
+        float gy = frame.cosine * gravity.y - frame.sine * gravity.x;
+        float x = gx + states.coriolisX[i] + states.centrifugalX[i];
+        float y = gy + states.coriolisY[i] + states.centrifugalY[i];
+        check(std::sqrt(x * x + y * y) < 1e-3f * gravity.magnitude(), "gravity and the fictitious accelerations cancel on the pair");
+    }
+    check(frame.origin.magnitude() < 1e-3f, "the origin is the barycenter");
+}
+
+// Paths relative to a body are the differences of the world paths, and the
+// velocity frame is turned along the velocity of the reference body
+void testRelativePaths() {
+    float strength = 66700000;
+    PhysicsWorld world;
+    circularPair(world, strength, 200, 10, 1);
+    world.addBody(PhysicsBody(Vector2D(0, 400), Vector2D(150, 0), 1));
+    applyGravitationalForces(strength, world);
+    Predictor predictor(strength);
+    predictor.trackedBody = 2;
+    predictor.steps = 100;
+    predictor.predict(world);
+    Propagation &propagation = predictor.propagation;
+    RelativeTrajectoryEngine engine;
+    engine.setPropagation(&propagation, nullptr);
+
+    RelativePath &relative = engine.path(2, 0);
+    RelativePath &absolute = engine.path(2, -1);
+    bool differences = relative.size() == propagation.size() && absolute.size() == propagation.size();
+    for (int k = 0; differences && k < propagation.size(); k++) {
+        Vector2D d = propagation.position(2, k) - propagation.position(0, k);
+        differences = relative.x[k] == d.x && relative.y[k] == d.y && absolute.point(k).x == propagation.position(2, k).x;
+    }
+    check(differences, "relative paths are differences of the world paths");
+    check(&engine.path(2, 0) == &relative, "a path is computed once per pair");
+
+    RelativePath &rotated = engine.path(2, 0, FrameRotation::Velocity);
+    float worst = 0;
+    for (int k = 0; k < propagation.size(); k++) {
+        // The x axis of the frame points along the velocity of the reference body
+        Vector2D axis = propagation.velocity(0, k).normalized();
+        Vector2D d = relative.point(k);
+        Vector2D expected(axis.x * d.x + axis.y * d.y, axis.x * d.y - axis.y * d.x);
+        worst = std::max(worst, (rotated.point(k) - expected).magnitude());
+        worst = std::max(worst, (engine.evaluate(2, 0, propagation.times[k], FrameRotation::Velocity) - expected).magnitude());
+    }
+    check(worst < 1e-2f, "the velocity frame is aligned with the reference body's velocity");
+}
+
+// On an eccentric pair of unequal masses, paths in the barycentric frame of
+// the engine match the bodies transformed by the co-rotating frame
+void testBarycentricPaths() {
+    float strength = 66700000;
+    PhysicsWorld world;
+    circularPair(world, strength, 200, 10, 3);
+    world.bodies[1].velocity *= 0.8f;
+    world.addBody(PhysicsBody(Vector2D(0, 400), Vector2D(150, 0), 1));
+    applyGravitationalForces(strength, world);
+    Predictor predictor(strength);
+    predictor.trackedBody = 1;
+    predictor.steps = 200;
+    predictor.predict(world);
+    Propagation &propagation = predictor.propagation;
+    RelativeTrajectoryEngine engine;
+    engine.setPropagation(&propagation, nullptr);
+
+    CorotatingFrame frame;
+    float worst = 0;
+    for (int k = 0; k < propagation.size(); k += 10) {
+        PhysicsWorld sample;
+        for (int i = 0; i < 3; i++) {
+            sample.addBody(PhysicsBody(propagation.position(i, k), propagation.velocity(i, k), world.bodies[i].mass));
+        }
+        frame.update(sample);
+        for (int i = 0; i < 3; i++) {
+            RelativePath &path = engine.path(i, 0, FrameRotation::Barycentric, 1);
+            Vector2D evaluated = engine.evaluate(i, 0, propagation.times[k], FrameRotation::Barycentric, 1);
+            worst = std::max(worst, std::fabs(path.x[k] - frame.states.x[i]) + std::fabs(path.y[k] - frame.states.y[i]));
+            worst = std::max(worst, std::fabs(evaluated.x - frame.states.x[i]) + std::fabs(evaluated.y - frame.states.y[i]));
+        }
+    }
+    check(propagation.size() > 100, "the eccentric pair is predicted");
+    check(worst < 1e-2f, "barycentric paths line up with the co-rotating bodies");
+}
+
+// A body at rest where the effective potential is flat feels no acceleration in the frame
+void testEffectivePotential() {
+    float strength = 66700000;
+    PhysicsWorld world;
+    circularPair(world, strength, 200, 10, 1);
+    CorotatingFrame frame;
+    frame.update(world);
+    // The frame starts aligned with the world, so both share coordinates.
+    std::vector<Vector2D> sources = {world.bodies[0].position, world.bodies[1].position};
+    PotentialField field(strength);
+    field.update(sources, frame.omega, frame.origin, Vector2D(0, 0), Vector2D(4, 0), Vector2D(0, 4), 8, 8);
+
+    // The point beyond the secondary where the slope of the potential along
+    // the axis changes sign, the second Lagrange point.
+    float low = world.bodies[1].position.x + 10, high = 1000;
+    for (int i = 0; i < 40; i++) {
+        float middle = (low + high) / 2;
+        float slope = field.evaluate(Vector2D(middle + 1, 0)) - field.evaluate(Vector2D(middle - 1, 0));
+        if (slope > 0) low = middle;
+        else high = middle;
+    }
+    float x = (low + high) / 2;
+    world.addBody(PhysicsBody(Vector2D(x, 0), Vector2D(0, frame.omega * x), 1));
+    frame.update(world);
+    applyGravitationalForces(strength, world);
+    CorotatingStates &states = frame.states;
+    Vector2D gravity = world.bodies[2].acceleration;
+    float ax = gravity.x + states.coriolisX[2] + states.centrifugalX[2];
+    float ay = gravity.y + states.coriolisY[2] + states.centrifugalY[2];
+    check(std::sqrt(ax * ax + ay * ay) < 1e-2f * gravity.magnitude(), "a flat point of the effective potential is an equilibrium");
+}
+
+// A followed body is approached at the same speed at any frame rate, and a
+// moved parent moves the cached transform of its child
+void testFrameNode() {
+    PhysicsBody body(Vector2D(100, 0), Vector2D(0, 0), 1);
+    FrameNode slowRoot(nullptr, Vector2D(0, 0), 0, Vector2D(1, 1));
+    FrameNode fastRoot(nullptr, Vector2D(0, 0), 0, Vector2D(1, 1));
+    slowRoot.follow(&body, 0.01f);
+    fastRoot.follow(&body, 0.01f);
+    for (int i = 0; i < 30; i++) slowRoot.tick(1.0f / 30);
+    for (int i = 0; i < 144; i++) fastRoot.tick(1.0f / 144);
+    check(near(slowRoot.getPosition().x, fastRoot.getPosition().x, 1e-2f), "following does not depend on the frame rate");
+    check(near(slowRoot.getPosition().x, 100 * (1 - std::pow(0.99f, 60)), 1e-2f), "one second of following covers 60 steps of the rate");
+
+    FrameNode child(&slowRoot, Vector2D(10, 0), 0, Vector2D(2, 2));
+    Vector2D before = child.getLocalCoordinates(Vector2D(0, 0));
+    slowRoot.setPosition(Vector2D(-5, 0));
+    Vector2D after = child.getLocalCoordinates(Vector2D(0, 0));
+    check(near(after.x, (5 - 10) * 2, 1e-4f) && !near(before.x, after.x, 1), "moving a parent moves its child");
+}
+
+// An uneven parallelFor runs every index once, also when nested in a job of the pool
+void testParallelFor() {
+    ThreadPool pool(3);
+    std::vector<std::atomic<int>> hits(1000);
+    pool.parallelFor(0, 1000, [&hits](int i) {
+        // Later indices take longer, so the chunks finish unevenly
+        volatile float sink = 0;
+        for (int k = 0; k < i * 20; k++) sink = sink + k;
+        hits[i]++;
+    });
+    bool once = true;
+    for (int i = 0; i < 1000; i++) once = once && hits[i] == 1;
+    check(once, "an uneven parallel loop runs every index once");
+
+    std::vector<std::atomic<int>> nested(16 * 100);
+    pool.parallelFor(0, 16, [&pool, &nested](int outer) {
+        pool.parallelFor(0, 100, [&nested, outer](int inner) {
+            nested[outer * 100 + inner]++;
+        });
+    });
+    once = true;
+    for (int i = 0; i < nested.size(); i++) once = once && nested[i] == 1;
+    check(once, "nested parallel loops finish and run every index once");
+}
+
+// A tessellated circle stays within the tolerance in pixels at any scale, and
+// a straight line needs no more than the least subdivision
+void testTessellation() {
+    AdaptiveTessellator tessellator;
+    auto circle = [](float t) { return Vector2D(100 * std::cos(t), 100 * std::sin(t)); };
+    std::vector<Vector2D> coarse, fine;
+    tessellator.tessellate(1, circle, 0, 2 * M_PI, 4, coarse);
+    tessellator.tessellate(8, circle, 0, 2 * M_PI, 4, fine);
+    float worst = 0;
+    for (int i = 0; i + 1 < fine.size(); i++) {
+        // The farthest point of an arc from its chord is the sagitta.
+        float half = 0.5f * (fine[i + 1] - fine[i]).magnitude();
+        worst = std::max(worst, 100 - std::sqrt(100 * 100 - half * half));
+    }
+    check(worst * 8 <= tessellator.tolerance, "the circle is within the tolerance in pixels");
+    check(fine.size() > coarse.size(), "zooming in refines the polyline");
+    check(near(fine.front().x, fine.back().x, 1e-2f) && near(fine.front().y, fine.back().y, 1e-2f), "the polyline ends where the curve ends");
+
+    std::vector<Vector2D> line;
+    tessellator.tessellate(8, [](float t) { return Vector2D(t, 2 * t); }, 0, 100, 3, line);
+    check(line.size() == 3 * (1 << tessellator.minDepth) + 1, "a straight line is only subdivided the least number of times");
+}
+
+// A circular orbit closes, and is reused and moved when the pair is found on it
+// again somewhere else, but not when the body has left it
+void testClosedOrbit() {
+    float strength = 66700000;
+    PhysicsWorld world;
+    circularPair(world, strength, 200, 10, 1);
+    applyGravitationalForces(strength, world);
+    Predictor predictor(strength);
+    predictor.trackedBody = 1;
+    predictor.steps = 1000;
+    predictor.predict(world);
+    float omega = std::sqrt(strength / (200.0f * 200 * 200) * (1 / 10.0f + 1));
+    check(predictor.end == PredictionEnd::Closed && !predictor.reused, "a circular orbit closes");
+    check(predictor.reference == -1, "the automatic choice of the reference body is kept");
+    // About 60 steps per orbit leave the period a few percent off
+    check(near(predictor.period, 2 * M_PI / omega, 0.05f * predictor.period), "the closed orbit has the period of the circle");
+
+    // The pair a third of the way around the orbit, between two samples, and moved
+    Propagation &propagation = predictor.propagation;
+    EphemerisSet ephemeris;
+    ephemeris.fit(propagation, 0.25f);
+    int k = propagation.size() / 3;
+    float t = 0.5f * (propagation.times[k] + propagation.times[k + 1]);
+    Vector2D offset(50, -30);
+    PhysicsWorld moved;
+    for (int i = 0; i < 2; i++) {
+        Vector2D p, v;
+        propagation.interpolate(i, k, t, p, v);
+        moved.addBody(PhysicsBody(p + offset, v, world.bodies[i].mass));
+    }
+    applyGravitationalForces(strength, moved);
+    Vector2D before = propagation.position(1, 0);
+    predictor.predict(moved);
+    check(predictor.reused, "the orbit is reused when the pair is on it");
+    check(near(predictor.shift.x, offset.x, 0.1f) && near(predictor.shift.y, offset.y, 0.1f), "the reused orbit moves with the reference body");
+    check(near(propagation.position(1, 0).x, before.x + predictor.shift.x, 1e-3f), "the samples are moved by the shift");
+    ephemeris.translate(predictor.shift);
+    float worst = 0;
+    for (int i = 0; i < propagation.size(); i++) {
+        worst = std::max(worst, (ephemeris.bodies[1].position(propagation.times[i]) - propagation.position(1, i)).magnitude());
+    }
+    check(worst < 0.5f, "a translated ephemeris follows the moved samples");
+
+    // The body a few percent of the orbit farther out is off it
+    PhysicsWorld off = moved.clone();
+    off.bodies[1].position += (off.bodies[1].position - off.bodies[0].position) * 0.03f;
+    applyGravitationalForces(strength, off);
+    predictor.predict(off);
+    check(!predictor.reused, "the orbit is not reused when the body left it");
+}
+
+// Batched transforms through a frame chain agree with transforming point by point
+void testBatchTransform() {
+    FrameNode root(nullptr, Vector2D(30, -20), 0.4f, Vector2D(2, 2));
+    FrameNode child(&root, Vector2D(-5, 7), -1.1f, Vector2D(0.5f, 3));
+    const Affine2D &matrix = child.getMatrix();
+    std::vector<float> x(37), y(37), out(2 * 37), points(2 * 37);
+    std::vector<Vector2D> vectors(37);
+    for (int i = 0; i < 37; i++) {
+        x[i] = i * 3.5f - 40;
+        y[i] = 100 - i * i * 0.25f;
+        vectors[i] = Vector2D(x[i], y[i]);
+    }
+    Vector2D offset(12, -8);
+    matrix.transform(x.data(), y.data(), out.data(), 37, offset.x, offset.y);
+    matrix.transform(vectors.data(), points.data(), 37);
+    float worst = 0;
+    for (int i = 0; i < 37; i++) {
+        Vector2D one = child.getLocalCoordinates(vectors[i] + offset);
+        Vector2D plain = matrix.apply(vectors[i]);
+        worst = std::max(worst, std::fabs(out[2 * i] - one.x) + std::fabs(out[2 * i + 1] - one.y));
+        worst = std::max(worst, std::fabs(points[2 * i] - plain.x) + std::fabs(points[2 * i + 1] - plain.y));
+    }
+    check(worst < 1e-3f, "batched transforms match single points");
+    Affine2D back = matrix.inverse();
+    Vector2D p = back.apply(matrix.apply(Vector2D(17, -3)));
+    check(near(p.x, 17, 1e-3f) && near(p.y, -3, 1e-3f), "the inverse undoes the transformation");
+}
+
+struct Nothing : Drawable {
+    void draw(Camera *camera) {}
+};
+
+// A scene visits its buckets farthest first, and removing a drawable moves the
+// last one of its bucket into its slot
+void testScene() {
+    Nothing drawables[5];
+    int depths[5] = {1, 20, 1, 10, 1};
+    Scene scene;
+    for (int i = 0; i < 5; i++) check(scene.add(&drawables[i], depths[i]), "a new drawable is added");
+    check(!scene.add(&drawables[0], 3), "a drawable is only added once");
+    std::vector<int> order;
+    for (auto &bucket : scene.buckets) order.push_back(bucket.first);
+    check(order == std::vector<int>({20, 10, 1}), "buckets are visited farthest first");
+
+    check(scene.remove(&drawables[0]) && !scene.contains(&drawables[0]), "a removed drawable leaves the scene");
+    std::vector<Drawable*> &bucket = scene.buckets[1];
+    check(bucket.size() == 2 && bucket[0] == &drawables[4] && bucket[1] == &drawables[2], "the last drawable takes the removed slot");
+    check(scene.remove(&drawables[4]) && scene.remove(&drawables[2]) && scene.buckets[1].empty(), "the moved drawable is removed from its new slot");
+    check(!scene.remove(&drawables[4]) && scene.size() == 2, "removing twice changes nothing");
+}
+
+// A viewport sees the part of the world its frame maps onto its pixels, and
+// culls the chunks of a polyline outside of it
+void testCulling() {
+    Viewport viewport(0, 0, 200, 100);
+    FrameNode node(nullptr, Vector2D(1000, 0), 0, Vector2D(2, 2));
+    viewport.node = &node;
+    viewport.updateView();
+    Bounds &visible = viewport.visible;
+    check(near(visible.min.x, 950, 1e-3f) && near(visible.max.x, 1050, 1e-3f) &&
+          near(visible.min.y, -25, 1e-3f) && near(visible.max.y, 25, 1e-3f), "the visible bounds are the viewport in the world");
+    check(visible.intersects(Bounds::circle(Vector2D(1000, 28), 4)), "a circle reaching into the view is visible");
+    check(!visible.intersects(Bounds::circle(Vector2D(1000, 30), 4)), "a circle beside the view is culled");
+    check(!visible.intersects(Bounds()), "empty bounds are never visible");
+
+    std::vector<float> x(200), y(200, 0);
+    for (int i = 0; i < 200; i++) x[i] = i;
+    ChunkBounds chunks;
+    chunks.compute(x.data(), y.data(), 200);
+    check(chunks.chunks.size() == 4 && chunks.total.min.x == 0 && chunks.total.max.x == 199, "the chunks cover the polyline");
+    check(chunks.chunks[0].max.x == 64 && chunks.chunks[1].min.x == 64, "neighbouring chunks share a point");
+    node.setPosition(Vector2D(125, 0));
+    viewport.updateView();
+    int shown = 0;
+    for (int c = 0; c < chunks.chunks.size(); c++) {
+        if (viewport.visible.intersects(chunks.chunks[c])) shown |= 1 << c;
+    }
+    check(shown == 0b0110, "only the chunks in the view are drawn");
+}
+
+// Every radius up to the largest in the atlas finds a sprite within half a
+// step of it, and the sprites are packed without overlapping. The texture is
+// not needed for this, so the atlas is created without a renderer.
+void testAtlas() {
+    CircleAtlas atlas;
+    atlas.create(nullptr);
+    bool close = true;
+    for (int r = 1; r <= atlas.maxRadius; r++) {
+        int sprite = atlas.find(r);
+        if (sprite < 0) {
+            close = false;
+            continue;
+        }
+        int found = atlas.sprites[sprite].radius;
+        if (r <= atlas.exactRadius) close = close && found == r;
+        else close = close && std::abs(found - r) <= (atlas.step - 1) / 2 * r + 0.5f;
+    }
+    check(close, "every radius finds a sprite of nearly that radius");
+    check(atlas.find(0.3f) == 0, "circles below a pixel use the smallest sprite");
+    check(atlas.find(atlas.maxRadius + 1) == -1, "circles too large for the atlas find no sprite");
+
+    bool apart = true;
+    for (int i = 0; i < atlas.sprites.size(); i++) {
+        CircleSprite &a = atlas.sprites[i];
+        int size = 2 * a.radius + 1;
+        apart = apart && a.x >= 0 && a.y >= 0 && a.x + size <= atlas.width && a.y + size <= atlas.height;
+        for (int j = i + 1; j < atlas.sprites.size(); j++) {
+            CircleSprite &b = atlas.sprites[j];
+            int other = 2 * b.radius + 1;
+            apart = apart && (a.x + size <= b.x || b.x + other <= a.x || a.y + size <= b.y || b.y + other <= a.y);
+        }
+    }
+    check(apart, "the sprites fit in the atlas without overlapping");
+}
+
+// A prediction computed in slices ends up the same as one computed at once
+void testResumedPrediction() {
+    float strength = 66700000;
+    PhysicsWorld world;
+    world.addBody(PhysicsBody(Vector2D(320, 240), Vector2D(40, 0), 10));
+    world.addBody(PhysicsBody(Vector2D(320, 60), Vector2D(-400, 0), 1));
+    applyGravitationalForces(strength, world);
+
+    Predictor whole(strength), sliced(strength);
+    whole.trackedBody = sliced.trackedBody = 1;
+    whole.steps = sliced.steps = 500;
+    whole.watchAll(1, 2);
+    sliced.watchAll(1, 2);
+    whole.predict(world);
+
+    bool complete = sliced.start(world);
+    check(!complete && sliced.inProgress(), "a long prediction is not complete after start");
+    int slices = 0;
+    int grown = 0;
+    while (!complete) {
+        complete = sliced.resume(7);
+        slices++;
+        check(sliced.propagation.size() > grown, "every slice adds samples");
+        grown = sliced.propagation.size();
+    }
+    check(slices > 1, "the prediction took several slices");
+    check(!sliced.inProgress(), "a complete prediction is not in progress");
+    check(sliced.propagation.size() == whole.propagation.size(), "slices take as many steps as one go");
+    bool same = true;
+    for (int i = 0; i < whole.propagation.size() && i < sliced.propagation.size(); i++) {
+        same = same && whole.propagation.times[i] == sliced.propagation.times[i] &&
+               whole.propagation.position(1, i).x == sliced.propagation.position(1, i).x &&
+               whole.propagation.position(1, i).y == sliced.propagation.position(1, i).y;
+    }
+    check(same, "slices produce the same samples");
+    check(sliced.events.size() == whole.events.size() && sliced.end == whole.end, "slices find the same events");
+}
+
+int main(int argc, char *argv[]) {
+    ThreadPool::configure(2, false);
+    testSweptCircles();
+    testMerge();
+    testHermite();
+    testChebyshev();
+    testEventBisection();
+    testLiangBarsky();
+    testAppend();
+    testTripleBuffer();
+    testTaskGraph();
+    testCorotatingFrame();
+    testRelativePaths();
+    testBarycentricPaths();
+    testEffectivePotential();
+    testFrameNode();
+    testParallelFor();
+    testTessellation();
+    testClosedOrbit();
+    testBatchTransform();
+    testScene();
+    testAtlas();
+    testCulling();
+    testResumedPrediction();
+    if (failures == 0) std::printf("All checks passed\n");
+    return failures;
+}
@@ -0,0 +1,334 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <algorithm>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+class ThreadPool;
+
+/// @brief A job submitted with ThreadPool::spawn, which can be waited for.
+class TaskHandle {
+    private:
+        std::shared_ptr<std::atomic<bool>> done;
+        ThreadPool *pool = nullptr;
+
+    public:
+        TaskHandle() {}
+        TaskHandle(std::shared_ptr<std::atomic<bool>> done, ThreadPool *pool) : done(done), pool(pool) {}
+
+        /// @brief Check whether the job is done. A default constructed handle is always done.
+        bool ready() {
+            return done == nullptr || *done;
+        }
+
+        /// @brief Run queued jobs on the calling thread until the job is done, and sleep while there are none.
+        void wait();
+};
+
+/// @brief A fixed set of worker threads that run jobs, balanced by work stealing.
+/// @details Every worker has a queue of its own. Jobs submitted by a worker
+/// go to the back of its queue and it takes its own jobs newest first, which
+/// keeps nested work on the thread whose caches are warm. A worker without
+/// jobs steals the oldest job of another worker. Jobs submitted from threads
+/// outside the pool go to a shared queue that all workers take from.
+///
+/// The pool is meant to be shared by everything in the program, so that the
+/// number of busy threads never exceeds the number of cores: use global()
+/// instead of creating new pools, and configure() it before its first use.
+class ThreadPool {
+    private:
+        /// The jobs of one worker, or the shared queue.
+        struct Queue {
+            std::mutex mutex;
+            std::deque<std::function<void()>> jobs;
+        };
+
+        /// The work of a parallelFor, shared by the caller and the helpers it
+        /// submits. Helpers that start after all chunks are taken return
+        /// without touching the function, so the caller does not wait for them.
+        template <typename Function>
+        struct Loop {
+            Function function;
+            int begin;
+            int count;
+            int chunks;
+            std::atomic<int> next{0};
+            std::atomic<int> done{0};
+
+            Loop(Function function, int begin, int count, int chunks) : function(function) {
+                this->begin = begin;
+                this->count = count;
+                this->chunks = chunks;
+            }
+
+            /// Run the next chunk, or return false if all are taken.
+            bool runChunk() {
+                int c = next++;
+                if (c >= chunks) return false;
+                int first = begin + (long long)count * c / chunks;
+                int last = begin + (long long)count * (c + 1) / chunks;
+                for (int i = first; i < last; i++) function(i);
+                done++;
+                return true;
+            }
+        };
+
+        struct Settings {
+            int threads = -1;
+            bool pin = false;
+        };
+
+        std::vector<std::thread> workers;
+        /// One queue per worker, followed by the shared queue.
+        std::vector<std::unique_ptr<Queue>> queues;
+        int count;
+        std::mutex sleepMutex;
+        std::condition_variable available;
+        /// Wakes threads that wait for jobs to finish.
+        std::condition_variable progress;
+        /// The number of threads asleep in helpUntil, which also wake up for new jobs.
+        /// Changed under sleepMutex, but read by submit without it.
+        std::atomic<int> waiting{0};
+        /// The number of workers asleep waiting for jobs. Changed under sleepMutex, but read by submit without it.
+        std::atomic<int> sleeping{0};
+        /// The number of jobs in all queues.
+        std::atomic<int> queued{0};
+        std::atomic<bool> stopping{false};
+        /// The pool and worker index of the calling thread, if it is a worker.
+        inline static thread_local ThreadPool *owner = nullptr;
+        inline static thread_local int worker = -1;
+
+        static Settings &settings() {
+            static Settings settings;
+            return settings;
+        }
+
+        /// Get the queue jobs from the calling thread go to.
+        int home() {
+            return owner == this ? worker : count;
+        }
+
+        bool take(int queue, std::function<void()> &job, bool newest) {
+            Queue &q = *queues[queue];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if (q.jobs.empty()) return false;
+            if (newest) {
+                job = std::move(q.jobs.back());
+                q.jobs.pop_back();
+            } else {
+                job = std::move(q.jobs.front());
+                q.jobs.pop_front();
+            }
+            queued--;
+            return true;
+        }
+
+        /// Find a job for the calling thread: its own newest job, then the
+        /// oldest shared job, then the oldest job of another worker.
+        bool find(std::function<void()> &job) {
+            int own = home();
+            if (own < count && take(own, job, true)) return true;
+            if (take(count, job, false)) return true;
+            int start = own < count ? own + 1 : 0;
+            for (int k = 0; k < count; k++) {
+                int victim = (start + k) % count;
+                if (victim != own && take(victim, job, false)) return true;
+            }
+            return false;
+        }
+
+        void work(int index) {
+            owner = this;
+            worker = index;
+            while (true) {
+                std::function<void()> job;
+                if (find(job)) {
+                    job();
+                    continue;
+                }
+                std::unique_lock<std::mutex> lock(sleepMutex);
+                // Counted before checking for jobs, so submit either sees the sleeper or the sleeper sees the job.
+                sleeping++;
+                available.wait(lock, [this] { return stopping || queued > 0; });
+                sleeping--;
+                if (stopping && queued == 0) return;
+            }
+        }
+
+        /// Bind a worker to core index + 1, so no worker is bound to core 0.
+        /// Threads outside the pool are not pinned. Workers beyond the last
+        /// core are left unbound instead of sharing a core with another worker.
+        static void pin(std::thread &thread, int index) {
+#ifdef __linux__
+            int cores = std::max(1, (int)std::thread::hardware_concurrency());
+            if (index >= cores - 1) return;
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(index + 1, &set);
+            pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+#endif
+        }
+
+    public:
+        /// @brief Create a thread pool.
+        /// @param threads The number of worker threads. A negative number uses
+        /// one per hardware thread, minus the calling thread. With zero workers,
+        /// all work runs on the threads that wait for it.
+        /// @param pinned Whether to bind workers to cores of their own, other than core 0.
+        ThreadPool(int threads = -1, bool pinned = false) {
+            if (threads < 0) threads = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+            count = threads;
+            for (int i = 0; i <= threads; i++) {
+                queues.push_back(std::make_unique<Queue>());
+            }
+            for (int i = 0; i < threads; i++) {
+                workers.emplace_back([this, i] { work(i); });
+                if (pinned) pin(workers.back(), i);
+            }
+        }
+
+        ~ThreadPool() {
+            {
+                std::lock_guard<std::mutex> lock(sleepMutex);
+                stopping = true;
+            }
+            available.notify_all();
+            for (int i = 0; i < workers.size(); i++) {
+                workers[i].join();
+            }
+        }
+
+        /// @brief Set the number of workers of the global pool and whether they are pinned.
+        /// @details This only has an effect before the first call to global().
+        /// @see ThreadPool(int, bool)
+        static void configure(int threads, bool pinned) {
+            settings().threads = threads;
+            settings().pin = pinned;
+        }
+
+        /// @brief Get the pool shared by the whole program.
+        static ThreadPool &global() {
+            static ThreadPool pool(settings().threads, settings().pin);
+            return pool;
+        }
+
+        /// @brief Get the number of worker threads.
+        int size() {
+            return count;
+        }
+
+        /// @brief Queue a job to be run by a worker.
+        void submit(std::function<void()> job) {
+            Queue &q = *queues[home()];
+            {
+                std::lock_guard<std::mutex> lock(q.mutex);
+                q.jobs.push_back(std::move(job));
+                queued++;
+            }
+            // Sleepers are counted before they check for jobs, so when none are
+            // counted here any that are about to sleep will see the new job.
+            bool workers = sleeping > 0;
+            bool helpers = waiting > 0;
+            if (!workers && !helpers) return;
+            // Taking the lock waits out a sleeper that is counted but not yet waiting.
+            { std::lock_guard<std::mutex> lock(sleepMutex); }
+            if (workers) available.notify_one();
+            if (helpers) progress.notify_all();
+        }
+
+        /// @brief Queue a job that can be waited for.
+        /// @param job The job.
+        /// @return A handle to wait for the job with.
+        TaskHandle spawn(std::function<void()> job) {
+            auto done = std::make_shared<std::atomic<bool>>(false);
+            submit([this, job, done] {
+                job();
+                *done = true;
+                wake();
+            });
+            return TaskHandle(done, this);
+        }
+
+        /// @brief Run one queued job on the calling thread, if there is one.
+        /// @details Threads that wait for jobs they submitted call this, so they help instead of blocking.
+        /// @return Whether a job was run.
+        bool helpOnce() {
+            std::function<void()> job;
+            if (!find(job)) return false;
+            job();
+            return true;
+        }
+
+        /// @brief Run queued jobs on the calling thread until a condition holds.
+        /// @param finished Checks the condition. The work that makes it true has to call wake() afterwards.
+        /// @details The calling thread helps as long as there are jobs, and
+        /// sleeps once there are none until a job is queued or it is woken.
+        template <typename Condition>
+        void helpUntil(Condition finished) {
+            while (!finished()) {
+                if (helpOnce()) continue;
+                std::unique_lock<std::mutex> lock(sleepMutex);
+                waiting++;
+                progress.wait(lock, [this, &finished] { return finished() || queued > 0; });
+                waiting--;
+            }
+        }
+
+        /// @brief Wake the threads waiting for jobs to finish, so they check whether theirs are done.
+        void wake() {
+            { std::lock_guard<std::mutex> lock(sleepMutex); }
+            progress.notify_all();
+        }
+
+        /// @brief Run a function for every index in a range, in parallel.
+        /// @param begin The first index.
+        /// @param end One past the last index.
+        /// @param function The function to call with every index.
+        /// @param grain The smallest number of indices worth giving to another thread.
+        /// @details The range is split into a few chunks per thread, which the
+        /// calling thread and helpers on the workers take one at a time, so
+        /// uneven chunks balance out. Ranges of less than two grains run on the
+        /// calling thread without touching the pool. The calling thread only
+        /// runs chunks of its own loop, then sleeps until the helpers finish
+        /// the chunks they took, and returns once all indices are done.
+        template <typename Function>
+        void parallelFor(int begin, int end, Function function, int grain = 1) {
+            int total = end - begin;
+            if (total <= 0) return;
+            grain = std::max(1, grain);
+            int chunks = std::min((total + grain - 1) / grain, (size() + 1) * 4);
+            if (chunks <= 1 || size() == 0) {
+                for (int i = begin; i < end; i++) function(i);
+                return;
+            }
+            auto loop = std::make_shared<Loop<Function>>(function, begin, total, chunks);
+            int helpers = std::min(chunks - 1, size());
+            for (int h = 0; h < helpers; h++) {
+                submit([this, loop] {
+                    while (loop->runChunk()) {}
+                    if (loop->done == loop->chunks) wake();
+                });
+            }
+            while (loop->runChunk()) {}
+            if (loop->done == chunks) return;
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            progress.wait(lock, [&loop, chunks] { return loop->done == chunks; });
+        }
+};
+
+inline void TaskHandle::wait() {
+    if (ready()) return;
+    pool->helpUntil([this] { return ready(); });
+}
+
+#endif
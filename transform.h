@@ -0,0 +1,265 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+#include "Vector2D.h"
+#include "Frame2D.h"
+#include "physics.h"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+/// @brief A 2D affine transformation stored as a matrix and a translation.
+/// @details A point p is mapped to (a * p.x + b * p.y + tx, c * p.x + d * p.y + ty).
+struct Affine2D {
+    float a = 1, b = 0, c = 0, d = 1;
+    float tx = 0, ty = 0;
+
+    /// @brief Get the transformation that leaves every point where it is.
+    static Affine2D identity() {
+        return Affine2D();
+    }
+
+    /// @brief Get the transformation from the parent of a frame into the frame.
+    /// @param position The position of the frame in its parent.
+    /// @param cosine The cosine of the rotation of the frame.
+    /// @param sine The sine of the rotation of the frame.
+    /// @param scale The scale of the frame.
+    static Affine2D toLocal(Vector2D position, float cosine, float sine, Vector2D scale) {
+        Affine2D m;
+        m.a = scale.x * cosine;
+        m.b = scale.x * sine;
+        m.c = -scale.y * sine;
+        m.d = scale.y * cosine;
+        m.tx = -(m.a * position.x + m.b * position.y);
+        m.ty = -(m.c * position.x + m.d * position.y);
+        return m;
+    }
+
+    /// @brief Get the transformation from world coordinates into a Frame2D.
+    /// @param frame The frame.
+    /// @details The transformation of a frame is affine, so it is recovered
+    /// from the images of three points. This walks the chain of parents three
+    /// times, once instead of once per transformed point.
+    static Affine2D fromFrame(Frame2D *frame) {
+        Vector2D origin = frame->getLocalCoordinates(Vector2D(0, 0));
+        Vector2D ex = frame->getLocalCoordinates(Vector2D(1, 0)) - origin;
+        Vector2D ey = frame->getLocalCoordinates(Vector2D(0, 1)) - origin;
+        Affine2D m;
+        m.a = ex.x;
+        m.b = ey.x;
+        m.c = ex.y;
+        m.d = ey.y;
+        m.tx = origin.x;
+        m.ty = origin.y;
+        return m;
+    }
+
+    /// @brief Get the transformation that applies this one and then another one.
+    Affine2D then(const Affine2D &next) const {
+        Affine2D m;
+        m.a = next.a * a + next.b * c;
+        m.b = next.a * b + next.b * d;
+        m.c = next.c * a + next.d * c;
+        m.d = next.c * b + next.d * d;
+        m.tx = next.a * tx + next.b * ty + next.tx;
+        m.ty = next.c * tx + next.d * ty + next.ty;
+        return m;
+    }
+
+    /// @brief Get the transformation that undoes this one.
+    Affine2D inverse() const {
+        float determinant = a * d - b * c;
+        Affine2D m;
+        m.a = d / determinant;
+        m.b = -b / determinant;
+        m.c = -c / determinant;
+        m.d = a / determinant;
+        m.tx = -(m.a * tx + m.b * ty);
+        m.ty = -(m.c * tx + m.d * ty);
+        return m;
+    }
+
+    /// @brief Transform a point.
+    Vector2D apply(Vector2D p) const {
+        return Vector2D(a * p.x + b * p.y + tx, c * p.x + d * p.y + ty);
+    }
+
+    /// @brief Transform a batch of points stored as separate coordinate arrays.
+    /// @param x The x coordinates.
+    /// @param y The y coordinates.
+    /// @param out Set to the transformed points, as interleaved x and y coordinates.
+    /// @param n The number of points.
+    /// @param offsetX Added to every x coordinate before transforming.
+    /// @param offsetY Added to every y coordinate before transforming.
+    void transform(const float *__restrict x, const float *__restrict y, float *__restrict out, int n,
+                   float offsetX = 0, float offsetY = 0) const {
+        float ma = a, mb = b, mc = c, md = d;
+        float mx = tx + a * offsetX + b * offsetY;
+        float my = ty + c * offsetX + d * offsetY;
+        for (int i = 0; i < n; i++) {
+            out[2 * i] = ma * x[i] + mb * y[i] + mx;
+            out[2 * i + 1] = mc * x[i] + md * y[i] + my;
+        }
+    }
+
+    /// @brief Transform a batch of points.
+    /// @param points The points.
+    /// @param out Set to the transformed points, as interleaved x and y coordinates.
+    /// @param n The number of points.
+    void transform(const Vector2D *__restrict points, float *__restrict out, int n) const {
+        float ma = a, mb = b, mc = c, md = d, mx = tx, my = ty;
+        for (int i = 0; i < n; i++) {
+            float x = points[i].x, y = points[i].y;
+            out[2 * i] = ma * x + mb * y + mx;
+            out[2 * i + 1] = mc * x + md * y + my;
+        }
+    }
+
+    /// @brief Get the factor by which lengths are scaled, averaged over both axes.
+    float scale() const {
+        return std::sqrt(std::fabs(a * d - b * c));
+    }
+};
+
+/// @brief A frame of reference in a hierarchy that caches its transformation.
+/// @details Like Frame2D, a frame has a position, rotation and scale relative to
+/// its parent. The transformation from world coordinates into the frame,
+/// including the sine and cosine of its rotation, is composed once and kept
+/// until the frame or one of its ancestors changes. Changes mark the frame and
+/// all of its descendants dirty, and the next request for the transformation
+/// recomposes it. A frame can follow a PhysicsBody, in which case tick() moves
+/// it towards the body by an amount that depends on the time since the last tick.
+class FrameNode {
+    private:
+        FrameNode *parent;
+        std::vector<FrameNode*> children;
+        Vector2D position;
+        float rotation;
+        float cosine;
+        float sine;
+        Vector2D scale;
+        bool dirty = true;
+        Affine2D matrix;
+        PhysicsBody *target = nullptr;
+        float followRate = 1;
+
+        void markDirty() {
+            // Descendants of a dirty frame are already dirty.
+            if (dirty) return;
+            dirty = true;
+            for (int i = 0; i < children.size(); i++) {
+                children[i]->markDirty();
+            }
+        }
+
+    public:
+        /// @brief Create a frame.
+        /// @param parent The parent frame, or nullptr for a frame in world coordinates.
+        /// @param position The position of the frame in its parent.
+        /// @param rotation The rotation of the frame relative to its parent, in radians.
+        /// @param scale The scale of the frame relative to its parent.
+        FrameNode(FrameNode *parent, Vector2D position, float rotation, Vector2D scale) {
+            this->parent = parent;
+            this->position = position;
+            this->scale = scale;
+            setRotation(rotation);
+            if (parent != nullptr) parent->children.push_back(this);
+        }
+
+        FrameNode(const FrameNode&) = delete;
+        FrameNode& operator=(const FrameNode&) = delete;
+
+        ~FrameNode() {
+            if (parent != nullptr) {
+                std::vector<FrameNode*> &siblings = parent->children;
+                siblings.erase(std::remove(siblings.begin(), siblings.end(), this), siblings.end());
+            }
+            for (int i = 0; i < children.size(); i++) {
+                children[i]->parent = nullptr;
+                children[i]->markDirty();
+            }
+        }
+
+        /// @brief Set the position of the frame in its parent.
+        void setPosition(Vector2D position) {
+            this->position = position;
+            markDirty();
+        }
+
+        /// @brief Get the position of the frame in its parent.
+        Vector2D getPosition() {
+            return position;
+        }
+
+        /// @brief Set the rotation of the frame relative to its parent, in radians.
+        void setRotation(float rotation) {
+            this->rotation = rotation;
+            cosine = std::cos(rotation);
+            sine = std::sin(rotation);
+            markDirty();
+        }
+
+        /// @brief Get the rotation of the frame relative to its parent, in radians.
+        float getRotation() {
+            return rotation;
+        }
+
+        /// @brief Set the scale of the frame relative to its parent.
+        void setScale(Vector2D scale) {
+            this->scale = scale;
+            markDirty();
+        }
+
+        /// @brief Get the scale of the frame relative to its parent.
+        Vector2D getScale() {
+            return scale;
+        }
+
+        /// @brief Get the transformation from world coordinates into the frame.
+        /// @details The transformation is only recomposed if the frame or one of its ancestors changed since the last call.
+        const Affine2D &getMatrix() {
+            if (dirty) {
+                Affine2D local = Affine2D::toLocal(position, cosine, sine, scale);
+                matrix = parent != nullptr ? parent->getMatrix().then(local) : local;
+                dirty = false;
+            }
+            return matrix;
+        }
+
+        /// @brief Get the coordinates of a world point in the frame.
+        Vector2D getLocalCoordinates(Vector2D point) {
+            return getMatrix().apply(point);
+        }
+
+        /// @brief The time the rate of a followed body refers to, in seconds.
+        static constexpr float followStep = 1.0f / 60;
+
+        /// @brief Get the fraction of the distance to cover in a tick of any length.
+        /// @param rate The fraction of the distance covered in every followStep.
+        /// @param dt The length of the tick, in seconds.
+        static float blend(float rate, float dt) {
+            return 1 - std::pow(1 - rate, dt / followStep);
+        }
+
+        /// @brief Make the frame follow a body.
+        /// @param body The body to follow, or nullptr to stop following.
+        /// @param rate The fraction of the distance to the body covered in every followStep.
+        void follow(PhysicsBody *body, float rate) {
+            target = body;
+            followRate = rate;
+        }
+
+        /// @brief Move the frame and its descendants towards the bodies they follow.
+        /// @param dt The time since the last tick, in seconds.
+        /// @details Call this once per rendered frame on the root frame. The
+        /// frames close in on their bodies at the same speed at any frame rate.
+        void tick(float dt) {
+            if (target != nullptr) {
+                setPosition(Vector2D::lerp(position, target->getPosition(), blend(followRate, dt)));
+            }
+            for (int i = 0; i < children.size(); i++) {
+                children[i]->tick(dt);
+            }
+        }
+};
+
+#endif
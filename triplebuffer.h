@@ -0,0 +1,56 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+#include <atomic>
+#include <cstdint>
+
+/// @brief Hands the latest value from one writer thread to one reader thread without locks.
+/// @details There are three slots. The writer fills the back slot, the reader
+/// holds the front slot, and the middle slot holds the latest published value.
+/// Publishing exchanges the back slot with the middle one, and taking the
+/// latest value exchanges the middle slot with the front one, each with a
+/// single atomic exchange, so neither thread ever waits for the other. Values
+/// that are published again before the reader takes them are dropped.
+///
+/// The reader owns its slot until the next update, so it may move the
+/// contents out of it. The writer has to fill every field of the back slot
+/// before publishing, since it may get back any slot.
+template <typename T>
+class TripleBuffer {
+    private:
+        T slots[3];
+        /// The index of the middle slot, with the fresh bit set if it was published and not read yet.
+        std::atomic<uint8_t> middle;
+        /// The slot of the writer.
+        uint8_t back = 0;
+        /// The slot of the reader.
+        uint8_t front = 2;
+        static const uint8_t fresh = 4;
+
+    public:
+        TripleBuffer() : middle(1) {}
+
+        /// @brief Get the slot to fill with the next value. Only call this from the writer.
+        T &write() {
+            return slots[back];
+        }
+
+        /// @brief Make the filled slot the latest value. Only call this from the writer.
+        void publish() {
+            back = middle.exchange(back | fresh, std::memory_order_acq_rel) & 3;
+        }
+
+        /// @brief Take the latest value, if one was published since the last update. Only call this from the reader.
+        /// @return Whether read() now returns a new value.
+        bool update() {
+            if ((middle.load(std::memory_order_acquire) & fresh) == 0) return false;
+            front = middle.exchange(front, std::memory_order_acq_rel) & 3;
+            return true;
+        }
+
+        /// @brief Get the value taken by the last update. Only call this from the reader.
+        T &read() {
+            return slots[front];
+        }
+};
+
+#endif